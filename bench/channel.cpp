@@ -0,0 +1,151 @@
+// Contended channel benchmark.
+//
+// Many senders and receivers share a channel with a tiny buffer, so most
+// operations block.  A channel in which senders and receivers share a single
+// condition variable is reproduced below for comparison.  Besides wall time,
+// the number of voluntary context switches is reported: each one is a thread
+// that went to sleep, typically after a wakeup that did not let it proceed.
+//
+// With a single condition variable, `notify_one` may wake a thread of the
+// same side, which goes back to sleep and swallows the notification; with
+// enough threads every sender and receiver ends up asleep.  The reference
+// therefore has to use `notify_all`.
+
+#include <cool/channel.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#define COOL_BENCH_HAS_RUSAGE 1
+#endif
+
+namespace
+{
+
+// Channel whose senders and receivers share a condition variable.
+template <typename T> class single_cv_channel
+{
+public:
+  explicit single_cv_channel(std::size_t buffer_size) : buffer_size_{buffer_size} {}
+
+  auto send(T value) -> void
+  {
+    {
+      auto l = std::unique_lock<std::mutex>{mutex_};
+      cv_.wait(l, [this] { return closed_ || buffer_.size() < buffer_size_; });
+      if (closed_)
+        return;
+      buffer_.push(std::move(value));
+    }
+    cv_.notify_all();
+  }
+
+  auto receive(T& value) -> bool
+  {
+    {
+      auto l = std::unique_lock<std::mutex>{mutex_};
+      cv_.wait(l, [this] { return closed_ || !buffer_.empty(); });
+      if (buffer_.empty())
+        return false;
+      value = std::move(buffer_.front());
+      buffer_.pop();
+    }
+    cv_.notify_all();
+    return true;
+  }
+
+  auto close() -> void
+  {
+    auto l = std::unique_lock<std::mutex>{mutex_};
+    closed_ = true;
+    cv_.notify_all();
+  }
+
+private:
+  std::size_t buffer_size_;
+  bool closed_ = false;
+  std::queue<T> buffer_;
+  std::condition_variable cv_;
+  std::mutex mutex_;
+};
+
+struct adaptor {
+  cool::channel<long> ch;
+
+  auto send(long value) -> void { ch.send(value); }
+
+  auto receive(long& value) -> bool { return static_cast<bool>(ch >> value); }
+
+  auto close() -> void { ch.close(); }
+};
+
+auto context_switches() -> long
+{
+#ifdef COOL_BENCH_HAS_RUSAGE
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_nvcsw;
+#else
+  return 0;
+#endif
+}
+
+template <typename Channel> auto run(const char* name, Channel& ch, int senders, int receivers, long messages) -> void
+{
+  const auto start_switches = context_switches();
+  const auto start = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < receivers; ++i)
+    threads.emplace_back([&ch] {
+      long value = 0;
+      while (ch.receive(value)) {
+      }
+    });
+
+  std::vector<std::thread> producers;
+  for (int i = 0; i < senders; ++i)
+    producers.emplace_back([&ch, messages, senders] {
+      for (long j = 0; j < messages / senders; ++j)
+        ch.send(j);
+    });
+
+  for (auto& t : producers)
+    t.join();
+  ch.close();
+  for (auto& t : threads)
+    t.join();
+
+  const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  const auto switches = context_switches() - start_switches;
+
+  std::printf("%-16s %3d x %-3d %10.0f msg/s %12ld context switches (%.3f per message)\n", name, senders, receivers,
+              static_cast<double>(messages) / elapsed, switches, static_cast<double>(switches) / static_cast<double>(messages));
+}
+
+} // namespace
+
+auto main(int argc, char** argv) -> int
+{
+  const long messages = argc > 1 ? std::atol(argv[1]) : 200000;
+  const int configurations[][2] = {{1, 1}, {4, 4}, {16, 16}, {64, 4}, {4, 64}};
+
+  for (const auto& c : configurations) {
+    {
+      single_cv_channel<long> ch{4};
+      run("single cv", ch, c[0], c[1], messages);
+    }
+    {
+      adaptor ch{cool::channel<long>(4u)};
+      run("split queues", ch, c[0], c[1], messages);
+    }
+  }
+}
@@ -0,0 +1,119 @@
+// Thread pool scheduling benchmark.
+//
+// Runs a tree of tiny tasks, each one enqueueing its children from a worker,
+// with the shared queue and with work stealing.  With the shared queue every
+// enqueue and dequeue goes through the same mutex; with work stealing, workers
+// mostly push to and take from their own deque.
+//
+// Then measures how fast an external thread submits tiny tasks with `enqueue`,
+// which creates a future, and with `post`, which doesn't.
+//
+// Last, splits a loop in chunks, enqueued one by one or through `parallel_for`.
+
+#include <cool/thread_pool.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+auto run(const char* name, cool::scheduling mode, std::size_t threads, int depth) -> void
+{
+  cool::thread_pool pool(threads, mode);
+  std::atomic<long> count{0};
+  const long total = (1L << (depth + 1)) - 1;
+
+  std::function<void(int)> spawn = [&](int d) {
+    count.fetch_add(1, std::memory_order_relaxed);
+    if (d > 0) {
+      pool.enqueue(spawn, d - 1);
+      pool.enqueue(spawn, d - 1);
+    }
+  };
+
+  const auto start = std::chrono::steady_clock::now();
+  pool.enqueue(spawn, depth);
+  while (count.load(std::memory_order_relaxed) < total)
+    std::this_thread::yield();
+  const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  pool.join();
+
+  std::printf("%-16s %3zu threads %12.0f tasks/s\n", name, threads, static_cast<double>(total) / elapsed);
+}
+
+auto submit(const char* name, bool post, std::size_t threads, long total) -> void
+{
+  cool::thread_pool pool(threads);
+  std::atomic<long> count{0};
+  const auto task = [&count] { count.fetch_add(1, std::memory_order_relaxed); };
+
+  const auto start = std::chrono::steady_clock::now();
+  for (long i = 0; i < total; ++i) {
+    if (post)
+      pool.post(task);
+    else
+      pool.enqueue(task);
+  }
+  while (count.load(std::memory_order_relaxed) < total)
+    std::this_thread::yield();
+  const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  pool.join();
+
+  std::printf("%-16s %3zu threads %12.0f tasks/s\n", name, threads, static_cast<double>(total) / elapsed);
+}
+
+auto loop(const char* name, cool::scheduling mode, std::size_t threads, std::size_t n, std::size_t grain) -> void
+{
+  cool::thread_pool pool(threads, mode);
+  std::atomic<long> sum{0};
+  const auto body = [&sum](std::size_t i) { sum.fetch_add(static_cast<long>(i & 1), std::memory_order_relaxed); };
+
+  const auto start = std::chrono::steady_clock::now();
+  if (grain == 0) {
+    pool.parallel_for(cool::indices(n), body, 64).get();
+  } else {
+    std::vector<std::future<void>> chunks;
+    for (std::size_t begin = 0; begin < n; begin += grain)
+      chunks.push_back(pool.enqueue([&body, begin, grain, n] {
+        for (auto i = begin; i < std::min(begin + grain, n); ++i)
+          body(i);
+      }));
+    for (auto& chunk : chunks)
+      chunk.get();
+  }
+  const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  pool.join();
+
+  std::printf("%-16s %3zu threads %12.0f indices/s\n", name, threads, static_cast<double>(n) / elapsed);
+}
+
+} // namespace
+
+auto main(int argc, char** argv) -> int
+{
+  const int depth = argc > 1 ? std::atoi(argv[1]) : 18;
+  const auto cores = std::max(1u, std::thread::hardware_concurrency());
+
+  for (auto threads = std::size_t{1}; threads <= cores; threads *= 2) {
+    run("shared queue", cool::scheduling::shared_queue, threads, depth);
+    run("work stealing", cool::scheduling::work_stealing, threads, depth);
+  }
+
+  for (auto threads = std::size_t{1}; threads <= cores; threads *= 2) {
+    submit("enqueue", false, threads, 1L << depth);
+    submit("post", true, threads, 1L << depth);
+  }
+
+  for (auto threads = std::size_t{1}; threads <= cores; threads *= 2) {
+    loop("chunks", cool::scheduling::shared_queue, threads, std::size_t{1} << depth, 64);
+    loop("parallel_for", cool::scheduling::shared_queue, threads, std::size_t{1} << depth, 0);
+    loop("parallel_for ws", cool::scheduling::work_stealing, threads, std::size_t{1} << depth, 0);
+  }
+}
@@ -0,0 +1,110 @@
+// Wait strategy benchmark.
+//
+// Measures the round-trip latency of a value bounced between two threads
+// through a pair of channels, and of a task handed to a single-threaded pool,
+// for each wait strategy.  Spinning strategies avoid the sleep and wake-up
+// system calls of parking, at the cost of keeping a core busy: the CPU time
+// spent per round trip is reported next to the latency.
+//
+// Spinning only pays off when both threads have a core of their own: with
+// fewer cores, a spinning thread burns the time slice of the thread it waits for.
+
+#include <cool/channel.hpp>
+#include <cool/thread_pool.hpp>
+#include <cool/wait_strategy.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+struct setting {
+  const char* name;
+  cool::wait_strategy strategy;
+};
+
+auto cpu_time() -> double { return static_cast<double>(std::clock()) / CLOCKS_PER_SEC; }
+
+auto report(const char* bench, const char* name, std::vector<double>& samples, double cpu) -> void
+{
+  std::sort(samples.begin(), samples.end());
+  const auto at = [&samples](double q) { return samples[static_cast<std::size_t>(q * (samples.size() - 1))] * 1e9; };
+
+  std::printf("%-14s %-16s p50 %9.0f ns  p99 %9.0f ns  p99.9 %9.0f ns  cpu %9.0f ns/round trip\n", bench, name, at(0.5),
+              at(0.99), at(0.999), cpu * 1e9 / static_cast<double>(samples.size()));
+}
+
+template <typename Backend> auto ping_pong(const char* bench, const setting& s, long rounds) -> void
+{
+  auto ping = cool::channel<long, Backend>(1u, s.strategy);
+  auto pong = cool::channel<long, Backend>(1u, s.strategy);
+
+  auto echo = std::thread{[ping, pong]() mutable {
+    auto v = 0L;
+    while (ping.receive(v) == cool::channel_status::ok)
+      pong.send(v);
+  }};
+
+  auto samples = std::vector<double>{};
+  samples.reserve(static_cast<std::size_t>(rounds));
+
+  const auto cpu = cpu_time();
+  for (long i = 0; i < rounds; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    ping.send(i);
+    pong.receive();
+    samples.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  }
+  const auto elapsed_cpu = cpu_time() - cpu;
+
+  ping.close();
+  echo.join();
+  report(bench, s.name, samples, elapsed_cpu);
+}
+
+auto pool_round_trip(const setting& s, long rounds) -> void
+{
+  cool::thread_pool pool{1, s.strategy};
+
+  auto samples = std::vector<double>{};
+  samples.reserve(static_cast<std::size_t>(rounds));
+
+  const auto cpu = cpu_time();
+  for (long i = 0; i < rounds; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    pool.enqueue([i] { return i; }).get();
+    samples.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  }
+  const auto elapsed_cpu = cpu_time() - cpu;
+
+  pool.join();
+  report("thread_pool", s.name, samples, elapsed_cpu);
+}
+
+} // namespace
+
+auto main(int argc, char** argv) -> int
+{
+  const long rounds = argc > 1 ? std::atol(argv[1]) : 20000;
+  const setting settings[] = {
+    {"block", cool::wait_strategy::block()},
+    {"spin_then_block", cool::wait_strategy::spin_then_block()},
+    {"yield", cool::wait_strategy::yield()},
+    {"busy_spin", cool::wait_strategy::busy_spin()},
+  };
+
+  for (const auto& s : settings)
+    ping_pong<cool::mutex_backend>("mutex", s, rounds);
+  for (const auto& s : settings)
+    ping_pong<cool::spsc_backend>("spsc", s, rounds);
+  for (const auto& s : settings)
+    ping_pong<cool::mpmc_backend>("mpmc", s, rounds);
+  for (const auto& s : settings)
+    pool_round_trip(s, rounds);
+}
@@ -0,0 +1,478 @@
+// Broadcast channel implementation.
+
+#ifndef COOL_BROADCAST_HXX_INCLUDED
+/// \exclude
+#define COOL_BROADCAST_HXX_INCLUDED
+
+#include <cool/channel.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <cool/channel_macros.hpp>
+
+namespace cool
+{
+
+/// What a broadcast channel does when its buffer is full because of a slow subscriber.
+///
+/// `block` makes the publisher wait until every subscriber has received the oldest message.
+/// `drop_oldest` overwrites it; slow subscribers skip the messages they missed.
+/// `disconnect` overwrites it too, but slow subscribers are disconnected instead.
+///
+/// \module Channel
+enum class broadcast_policy { block, drop_oldest, disconnect };
+
+/// \exclude
+namespace detail
+{
+
+// Position of a subscriber in the stream of messages.
+struct broadcast_cursor {
+  std::uint64_t next = 0;
+  std::uint64_t dropped = 0;
+  bool connected = false;
+};
+
+// Messages are stored once, in a power-of-two ring indexed by their sequence
+// number, and each subscriber keeps the sequence of the next message it reads.
+//
+// With the blocking policy, every slot counts the subscribers that have not
+// received its message yet: the publisher waits until the slot it reuses drops
+// to zero.  Publishing only sets that count, so its cost does not depend on
+// the number of subscribers.  With the other policies the publisher never
+// waits, and subscribers find out they lagged behind when they next receive.
+template <typename T> class broadcast_state
+{
+  static_assert(std::is_nothrow_move_constructible<T>::value, "T must be nothrow move constructible");
+
+public:
+  broadcast_state(std::size_t capacity, broadcast_policy policy, wait_strategy strategy)
+    : mask_{ceil_pow2(capacity) - 1},
+      policy_{policy},
+      strategy_{strategy},
+      messages_{new received<T>[mask_ + 1]},
+      pending_{policy == broadcast_policy::block ? new std::size_t[mask_ + 1]() : nullptr}
+  {
+  }
+
+  template <typename U, typename W> auto publish(U&& value, W wait) -> channel_status
+  {
+    return publish_value(std::forward<U>(value), wait, std::is_nothrow_constructible<T, U&&>{});
+  }
+
+  template <typename F, typename W> auto receive(broadcast_cursor& c, F&& f, W wait) -> channel_status
+  {
+    auto notify = false;
+    {
+      std::unique_lock<std::mutex> l{mutex_};
+      if (!c.connected)
+        return channel_status::closed;
+
+      ++receivers_;
+      wait(strategy_, not_empty_, l, [this, &c] { return closed_ || c.next != head_; });
+      --receivers_;
+
+      if (c.next == head_)
+        return closed_ ? channel_status::closed : channel_status::timeout;
+
+      if (head_ - c.next > capacity()) {
+        if (policy_ == broadcast_policy::disconnect) {
+          c.connected = false;
+          --subscribers_;
+          return channel_status::closed;
+        }
+        c.dropped += head_ - capacity() - c.next;
+        c.next = head_ - capacity();
+      }
+
+      const auto i = static_cast<std::size_t>(c.next & mask_);
+      f(static_cast<const T&>(*messages_[i]));
+      ++c.next;
+
+      notify = pending_ && --pending_[i] == 0 && publishers_ > 0;
+    }
+    if (notify)
+      not_full_.notify_all();
+    return channel_status::ok;
+  }
+
+  auto subscribe() -> broadcast_cursor
+  {
+    std::lock_guard<std::mutex> l{mutex_};
+    ++subscribers_;
+
+    auto c = broadcast_cursor{};
+    c.next = head_;
+    c.connected = true;
+    return c;
+  }
+
+  auto unsubscribe(broadcast_cursor& c) noexcept -> void
+  {
+    auto notify = false;
+    {
+      std::lock_guard<std::mutex> l{mutex_};
+      if (!c.connected)
+        return;
+
+      c.connected = false;
+      --subscribers_;
+
+      if (pending_) {
+        for (auto seq = c.next; seq != head_; ++seq)
+          notify = --pending_[seq & mask_] == 0 || notify;
+        notify = notify && publishers_ > 0;
+      }
+    }
+    if (notify)
+      not_full_.notify_all();
+  }
+
+  auto close() noexcept -> void
+  {
+    {
+      std::lock_guard<std::mutex> l{mutex_};
+      closed_ = true;
+    }
+    not_full_.notify_all();
+    not_empty_.notify_all();
+  }
+
+  NODISCARD auto is_closed() const noexcept -> bool
+  {
+    std::lock_guard<std::mutex> l{mutex_};
+    return closed_;
+  }
+
+  NODISCARD auto subscribers() const noexcept -> std::size_t
+  {
+    std::lock_guard<std::mutex> l{mutex_};
+    return subscribers_;
+  }
+
+  NODISCARD auto capacity() const noexcept -> std::size_t { return mask_ + 1; }
+
+  NODISCARD auto policy() const noexcept -> broadcast_policy { return policy_; }
+
+private:
+  template <typename U, typename W> auto publish_value(U&& value, W wait, std::true_type) -> channel_status
+  {
+    auto receivers = std::size_t{0};
+    {
+      std::unique_lock<std::mutex> l{mutex_};
+      if (pending_) {
+        ++publishers_;
+        wait(strategy_, not_full_, l, [this] { return closed_ || has_space(); });
+        --publishers_;
+      }
+
+      if (closed_)
+        return channel_status::closed;
+      if (pending_ && !has_space())
+        return channel_status::timeout;
+
+      const auto i = static_cast<std::size_t>(head_ & mask_);
+      messages_[i].emplace(std::forward<U>(value));
+      if (pending_)
+        pending_[i] = subscribers_;
+      ++head_;
+
+      receivers = receivers_;
+    }
+    if (receivers > 0)
+      not_empty_.notify_all();
+    return channel_status::ok;
+  }
+
+  // Constructing `T` might throw once the oldest message is destroyed, so
+  // the value is built beforehand, outside of the lock.
+  template <typename U, typename W> auto publish_value(U&& value, W wait, std::false_type) -> channel_status
+  {
+    auto tmp = T(std::forward<U>(value));
+    return publish_value(std::move(tmp), wait, std::true_type{});
+  }
+
+  NODISCARD auto has_space() const noexcept -> bool { return head_ <= mask_ || pending_[head_ & mask_] == 0; }
+
+  const std::size_t mask_;
+  const broadcast_policy policy_;
+  const wait_strategy strategy_;
+  const std::unique_ptr<received<T>[]> messages_;
+  const std::unique_ptr<std::size_t[]> pending_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+  std::uint64_t head_ = 0;
+  std::size_t subscribers_ = 0;
+  std::size_t publishers_ = 0;
+  std::size_t receivers_ = 0;
+  bool closed_ = false;
+};
+
+} // namespace detail
+
+template <typename T> class broadcast;
+
+/// Receiving end of a [cool::broadcast]() channel.
+///
+/// Each subscription receives every message published after it was created,
+/// in publication order, independently of the other subscriptions.
+///
+/// \module Channel
+///
+/// \notes Subscriptions can be moved but not copied.
+/// \notes A subscription is unsubscribed when destroyed.
+/// \notes A subscription must not be used by several threads at once.
+template <typename T> class subscription
+{
+  friend class broadcast<T>;
+
+public:
+  /// \exclude
+  subscription(subscription&& other) noexcept : state_{std::move(other.state_)}, cursor_{other.cursor_}
+  {
+    other.cursor_.connected = false;
+  }
+
+  /// \exclude
+  auto operator=(subscription&& other) noexcept -> subscription&
+  {
+    if (this != &other) {
+      unsubscribe();
+      state_ = std::move(other.state_);
+      cursor_ = other.cursor_;
+      other.cursor_.connected = false;
+    }
+    return *this;
+  }
+
+  /// \exclude
+  ~subscription() { unsubscribe(); }
+
+  /// \group receive Receive data from the broadcast channel
+  ///
+  /// Receives a copy of the next message.
+  ///
+  /// \notes Caller is blocked if no message is available.
+  /// \notes Throws [cool::empty_closed_channel]() if the channel is closed and every
+  ///        message was received, or if the subscription is disconnected.
+  auto receive() -> T
+  {
+    received<T> value;
+    if (state_->receive(cursor_, [&value](const T& v) { value.emplace(v); }, detail::wait_forever{})
+        != channel_status::ok)
+      COOL_THROW(empty_closed_channel{"closed channel has no value"});
+    return *std::move(value);
+  }
+
+  /// Receives the next message by reference.
+  ///
+  /// Calls `f` with a constant reference to the message stored in the channel, which
+  /// is shared with the other subscriptions.
+  ///
+  /// \notes Caller is blocked if no message is available.
+  /// \notes Throws [cool::empty_closed_channel]() if the channel is closed and every
+  ///        message was received, or if the subscription is disconnected.
+  /// \notes `f` runs while the channel is locked.
+  template <typename F> auto receive_with(F f) -> void
+  {
+    if (state_->receive(cursor_, [&f](const T& v) { f(v); }, detail::wait_forever{}) != channel_status::ok)
+      COOL_THROW(empty_closed_channel{"closed channel has no value"});
+  }
+
+  /// \group receive_status Receive data from the broadcast channel reporting a status
+  ///
+  /// Copies the next message into `value`.
+  ///
+  /// (1) blocks until a message is available.
+  ///
+  /// (2) never blocks.
+  ///
+  /// (3) and (4) block for at most `rel_time` or until `time` is reached.
+  ///
+  /// \returns `ok` if a message was received, `timeout` if none was available in time,
+  ///          and `closed` if the channel is closed and every message was received,
+  ///          or if the subscription is disconnected.
+  auto receive(T& value) -> channel_status
+  {
+    return state_->receive(cursor_, [&value](const T& v) { value = v; }, detail::wait_forever{});
+  }
+
+  /// \group receive_status
+  NODISCARD auto try_receive(T& value) -> channel_status
+  {
+    return state_->receive(cursor_, [&value](const T& v) { value = v; }, detail::no_wait{});
+  }
+
+  /// \group receive_status
+  template <typename Rep, typename Period>
+  auto receive_for(T& value, const std::chrono::duration<Rep, Period>& rel_time) -> channel_status
+  {
+    return receive_until(value, std::chrono::steady_clock::now() + rel_time);
+  }
+
+  /// \group receive_status
+  template <typename Clock, typename Duration>
+  auto receive_until(T& value, const std::chrono::time_point<Clock, Duration>& time) -> channel_status
+  {
+    return state_->receive(cursor_, [&value](const T& v) { value = v; }, detail::wait_until_time<Clock, Duration>{time});
+  }
+
+  /// Stops receiving messages.
+  ///
+  /// \notes Messages not received yet no longer hold back the publisher.
+  /// \notes If the subscription is already disconnected, nothing happens.
+  auto unsubscribe() noexcept -> void
+  {
+    if (state_)
+      state_->unsubscribe(cursor_);
+  }
+
+  /// Queries whether the subscription still receives messages.
+  ///
+  /// \notes A subscription gets disconnected when unsubscribed, or when it lags behind
+  ///        with [cool::broadcast_policy]() `disconnect` and attempts to receive.
+  NODISCARD auto is_connected() const noexcept -> bool { return cursor_.connected; }
+
+  /// Returns how many messages were skipped because they were overwritten before being received.
+  ///
+  /// \notes Only [cool::broadcast_policy]() `drop_oldest` skips messages.
+  NODISCARD auto dropped() const noexcept -> std::uint64_t { return cursor_.dropped; }
+
+private:
+  explicit subscription(std::shared_ptr<detail::broadcast_state<T>> state)
+    : state_{std::move(state)}, cursor_{state_->subscribe()}
+  {
+  }
+
+  std::shared_ptr<detail::broadcast_state<T>> state_;
+  detail::broadcast_cursor cursor_;
+};
+
+/// Broadcast channels deliver each message to every subscriber.
+///
+/// Messages are stored once in a fixed-size buffer, and each [cool::subscription]()
+/// reads them at its own pace.  The [cool::broadcast_policy]() chosen at construction
+/// decides what happens when a slow subscriber lets the buffer fill up.
+///
+/// \module Channel
+///
+/// \notes After constructed, following copies refer to the same channel.
+/// \notes The capacity is rounded up to the next power of two.
+/// \notes `T` must be copy constructible and nothrow move constructible.
+template <typename T> class broadcast
+{
+public:
+  /// Constructs a new broadcast channel buffering up to `capacity` messages.
+  ///
+  /// \notes Blocked calls wait according to `strategy`.
+  explicit broadcast(std::size_t capacity, broadcast_policy policy = broadcast_policy::block,
+                     wait_strategy strategy = wait_strategy::block())
+    : state_{std::make_shared<detail::broadcast_state<T>>(capacity, policy, strategy)}
+  {
+  }
+
+  /// Subscribes to the messages published from now on.
+  NODISCARD auto subscribe() -> subscription<T> { return subscription<T>{state_}; }
+
+  /// \group publish Publish data to every subscriber
+  ///
+  /// Publishes a message.
+  ///
+  /// \notes With [cool::broadcast_policy]() `block`, caller is blocked while the buffer is full.
+  /// \notes Throws [cool::closed_channel]() if channel is closed.
+  auto publish(const T& value) -> void { check(state_->publish(value, detail::wait_forever{})); }
+
+  /// \group publish
+  auto publish(T&& value) -> void { check(state_->publish(std::move(value), detail::wait_forever{})); }
+
+  /// \group try_publish Publish data to every subscriber without blocking
+  ///
+  /// Publishes a message if there is room for it right away.
+  ///
+  /// \returns `true` if the message was published, `false` if the buffer is full.
+  /// \notes Only the `block` policy can find the buffer full.
+  /// \notes Throws [cool::closed_channel]() if channel is closed.
+  NODISCARD auto try_publish(const T& value) -> bool { return check(state_->publish(value, detail::no_wait{})); }
+
+  /// \group try_publish
+  NODISCARD auto try_publish(T&& value) -> bool { return check(state_->publish(std::move(value), detail::no_wait{})); }
+
+  /// \group publish_status Publish data to every subscriber reporting a status
+  ///
+  /// Same as `publish` and `try_publish`, but a closed channel is reported as
+  /// [cool::channel_status]() `closed` instead of an exception.
+  ///
+  /// \returns `ok` if the message was published, `timeout` if the buffer is full
+  ///          when not blocking, and `closed` if the channel is closed.
+  auto publish(const T& value, std::nothrow_t) -> channel_status { return state_->publish(value, detail::wait_forever{}); }
+
+  /// \group publish_status
+  auto publish(T&& value, std::nothrow_t) -> channel_status
+  {
+    return state_->publish(std::move(value), detail::wait_forever{});
+  }
+
+  /// \group publish_status
+  NODISCARD auto try_publish(const T& value, std::nothrow_t) -> channel_status
+  {
+    return state_->publish(value, detail::no_wait{});
+  }
+
+  /// \group publish_status
+  NODISCARD auto try_publish(T&& value, std::nothrow_t) -> channel_status
+  {
+    return state_->publish(std::move(value), detail::no_wait{});
+  }
+
+  /// Closes the channel.
+  ///
+  /// \notes Subscribers receive the messages still buffered before observing the closure.
+  /// \notes If the channel is already closed, nothing happens.
+  auto close() noexcept -> void { state_->close(); }
+
+  /// Queries whether the channel is closed or not.
+  NODISCARD auto is_closed() const noexcept -> bool { return state_->is_closed(); }
+
+  /// Returns the number of connected subscribers.
+  NODISCARD auto subscribers() const noexcept -> std::size_t { return state_->subscribers(); }
+
+  /// Returns the number of messages the buffer holds.
+  NODISCARD auto capacity() const noexcept -> std::size_t { return state_->capacity(); }
+
+  /// Returns the slow-subscriber policy.
+  NODISCARD auto policy() const noexcept -> broadcast_policy { return state_->policy(); }
+
+  /// \group comparison Checks whether or not two broadcast channels are the same.
+  auto operator==(const broadcast& other) const noexcept -> bool { return state_ == other.state_; }
+
+  /// \group comparison
+  auto operator!=(const broadcast& other) const noexcept -> bool { return state_ != other.state_; }
+
+private:
+  // Returns whether the message was published.
+  static auto check(channel_status result) -> bool
+  {
+    if (result == channel_status::closed)
+      COOL_THROW(closed_channel{"channel is closed"});
+    return result == channel_status::ok;
+  }
+
+  std::shared_ptr<detail::broadcast_state<T>> state_;
+};
+
+} // namespace cool
+
+#include <cool/undef_channel_macros.hpp>
+
+#endif // COOL_BROADCAST_HXX_INCLUDED
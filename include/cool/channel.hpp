@@ -4,12 +4,25 @@
 /// \exclude
 #define COOL_CHANNEL_HXX_INCLUDED
 
+#include <cool/wait_strategy.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iterator>
+#include <limits>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <new>
 #include <stdexcept>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 #if __cplusplus >= 201703L
 /// \exclude
@@ -19,11 +32,7 @@
 #define RESULT_OF_T(F, ...) typename std::result_of<F(__VA_ARGS__)>::type
 #endif
 
-#if __cplusplus >= 201603L
-#define NODISCARD [[nodiscard]]
-#else
-#define NODISCARD
-#endif
+#include <cool/channel_macros.hpp>
 
 namespace cool
 {
@@ -46,44 +55,1571 @@ class closed_channel : public std::invalid_argument
 /// when one tries to receive data from a closed channel that has no available data.
 ///
 /// \module Channel
-/// \notes Uses the same constructors as [std::invalid_argument]().
-class empty_closed_channel : public std::invalid_argument
+/// \notes Uses the same constructors as [std::invalid_argument]().
+class empty_closed_channel : public std::invalid_argument
+{
+  using std::invalid_argument::invalid_argument;
+};
+
+/// Result of a channel operation that reports errors without exceptions.
+///
+/// `ok` means the operation completed, `timeout` that it would have blocked past its
+/// deadline, and `closed` that the channel is closed (and empty, when receiving).
+///
+/// \module Channel
+enum class channel_status { ok, timeout, closed };
+
+/// Default channel backend.
+///
+/// Elements are kept in a queue guarded by a mutex.  Any number of threads
+/// can send and receive, and the buffer can be unbounded or resized at runtime.
+///
+/// \module Channel
+struct mutex_backend {
+};
+
+/// Single-producer/single-consumer channel backend.
+///
+/// Elements are kept in a fixed-capacity lock-free ring buffer.  An uncontended
+/// transfer never takes a lock: blocked calls spin briefly before parking.
+///
+/// \module Channel
+/// \notes At most one thread may send and at most one thread may receive at a time.
+/// \notes The channel must be constructed with a buffer size, which cannot be changed.
+struct spsc_backend {
+};
+
+/// Multi-producer/multi-consumer channel backend.
+///
+/// Elements are kept in a fixed-capacity lock-free ring buffer in which every
+/// slot carries a sequence number.  Any number of threads can send and receive;
+/// blocked calls spin briefly before parking.
+///
+/// \module Channel
+/// \notes The channel must be constructed with a buffer size, which cannot be changed.
+/// \notes The buffer size is rounded up to the next power of two, and is at least two.
+/// \notes `T` must be nothrow move constructible.
+/// \notes Elements whose construction may throw are built before being moved into the buffer.
+struct mpmc_backend {
+};
+
+/// Priority channel backend.
+///
+/// Elements are kept in a binary heap guarded by a mutex, and received greatest
+/// first according to `Compare`, which defaults to `std::less<T>`.  Elements that
+/// compare equivalent are received in the order they were sent.
+///
+/// \module Channel
+/// \notes Sending and receiving take logarithmic time in the number of buffered elements.
+/// \notes The buffer can be unbounded or resized at runtime, as with [cool::mutex_backend]().
+/// \notes Elements are moved within the heap as others come and go, even if sent with
+///        `emplace_send`.
+template <typename Compare = void> struct priority_backend {
+};
+
+/// Priority channel backend with a few discrete priority levels.
+///
+/// Elements are kept in one queue per level, guarded by a mutex.  `LevelOf` is
+/// a function object type mapping an element to its level in `[0, Levels)`, and
+/// elements of lower levels are received first, each level in the order sent.
+///
+/// \module Channel
+/// \notes Sending takes constant time and receiving takes time linear in `Levels`.
+/// \notes Levels past the last one are treated as the last one.
+/// \notes The buffer can be unbounded or resized at runtime, as with [cool::mutex_backend]().
+/// \notes Bounded channels allocate room for the whole buffer in each level upfront.
+/// \notes The level of an element is only known once it is built, so `emplace_send` builds
+///        it first and then moves it into the queue of its level.
+template <std::size_t Levels, typename LevelOf> struct bucket_backend {
+  static_assert(Levels > 0, "there must be at least one priority level");
+};
+
+/// Instrumented channel backend.
+///
+/// Behaves as `Backend`, and additionally counts the channel traffic and the time
+/// spent blocked, which [cool::channel::stats]() reports.  Channels of other backends
+/// keep no statistics and pay nothing for them.
+///
+/// \module Channel
+/// \notes Counters are updated with relaxed atomic operations.
+template <typename Backend = mutex_backend> struct instrumented {
+};
+
+/// Snapshot of the statistics of an instrumented channel.
+///
+/// - `sends` and `receives` count the elements sent and received so far.
+/// - `depth` is the number of buffered elements, and `high_water_depth` the largest one observed.
+/// - `send_blocked` and `receive_blocked` add up the time senders waited on a full channel,
+///   and receivers on an empty one.
+/// - `closes` counts the calls to `close`.
+///
+/// \module Channel
+///
+/// \notes Each counter is read atomically, but not all of them at once: while the channel
+///        is in use, a snapshot may be slightly inconsistent, and depths are approximate.
+/// \notes Blocking time is not measured for batch operations.
+struct channel_stats {
+  std::uint64_t sends;
+  std::uint64_t receives;
+  std::uint64_t depth;
+  std::uint64_t high_water_depth;
+  std::chrono::nanoseconds send_blocked;
+  std::chrono::nanoseconds receive_blocked;
+  std::uint64_t closes;
+};
+
+/// Result of a non-blocking receive.
+///
+/// Holds the received value, if any, like a minimal `std::optional`.
+///
+/// \module Channel
+template <typename T> class received
+{
+public:
+  /// Constructs an empty result.
+  received() noexcept {}
+
+  /// \exclude
+  received(const received& other) : engaged_{false}
+  {
+    if (other.engaged_)
+      construct(other.value_);
+  }
+
+  /// \exclude
+  received(received&& other) noexcept(std::is_nothrow_move_constructible<T>::value) : engaged_{false}
+  {
+    if (other.engaged_)
+      construct(std::move(other.value_));
+  }
+
+  /// \exclude
+  auto operator=(const received& other) -> received&
+  {
+    if (this != &other) {
+      reset();
+      if (other.engaged_)
+        emplace(other.value_);
+    }
+    return *this;
+  }
+
+  /// \exclude
+  auto operator=(received&& other) noexcept(std::is_nothrow_move_constructible<T>::value) -> received&
+  {
+    if (this != &other) {
+      reset();
+      if (other.engaged_)
+        emplace(std::move(other.value_));
+    }
+    return *this;
+  }
+
+  /// \exclude
+  ~received() { reset(); }
+
+  /// Constructs the value in place, destroying the previous one if any.
+  template <typename... Args> auto emplace(Args&&... args) -> T&
+  {
+    reset();
+    construct(std::forward<Args>(args)...);
+    return value_;
+  }
+
+  /// Destroys the value if any.
+  auto reset() noexcept -> void
+  {
+    if (engaged_) {
+      value_.~T();
+      engaged_ = false;
+    }
+  }
+
+  /// \group has_value Checks whether a value was received.
+  NODISCARD auto has_value() const noexcept -> bool { return engaged_; }
+
+  /// \group has_value
+  explicit operator bool() const noexcept { return engaged_; }
+
+  /// \group access Accesses the received value.
+  ///
+  /// \notes The behaviour is undefined if there is no value.
+  auto operator*() & noexcept -> T& { return value_; }
+
+  /// \group access
+  auto operator*() const& noexcept -> const T& { return value_; }
+
+  /// \group access
+  auto operator*() && noexcept -> T&& { return std::move(value_); }
+
+  /// \group access
+  auto operator->() noexcept -> T* { return &value_; }
+
+  /// \group access
+  auto operator->() const noexcept -> const T* { return &value_; }
+
+private:
+  template <typename... Args> auto construct(Args&&... args) -> void
+  {
+    ::new (static_cast<void*>(&value_)) T(std::forward<Args>(args)...);
+    engaged_ = true;
+  }
+
+  union {
+    T value_;
+  };
+  bool engaged_ = false;
+};
+
+/// \exclude
+namespace detail
+{
+
+constexpr std::size_t cache_line_size = 64;
+constexpr std::size_t ring_initial_capacity = 16;
+
+template <typename T> struct identity {
+  using type = T;
+};
+
+inline auto ceil_pow2(std::size_t n) noexcept -> std::size_t
+{
+  auto result = std::size_t{1};
+  while (result < n && result <= std::numeric_limits<std::size_t>::max() / 2)
+    result <<= 1;
+  return result;
+}
+
+// Uninitialized ring buffer slot.
+template <typename T> union slot {
+  slot() noexcept {}
+  ~slot() {}
+
+  T value;
+};
+
+// Contiguous FIFO with power-of-two capacity.  It grows by doubling and never
+// shrinks, so steady-state traffic performs no allocation.
+template <typename T> class ring
+{
+public:
+  ring() = default;
+
+  ring(const ring&) = delete;
+  auto operator=(const ring&) -> ring& = delete;
+
+  ~ring()
+  {
+    while (!empty())
+      pop();
+  }
+
+  auto reserve(std::size_t n) -> void
+  {
+    if (n > capacity())
+      reallocate(ceil_pow2(n));
+  }
+
+  template <typename... Args> auto emplace(Args&&... args) -> void
+  {
+    if (size_ == capacity())
+      reallocate(size_ > 0 ? 2 * size_ : ring_initial_capacity);
+    ::new (static_cast<void*>(&at(size_))) T(std::forward<Args>(args)...);
+    ++size_;
+  }
+
+  template <typename U> auto push(U&& value) -> void { emplace(std::forward<U>(value)); }
+
+  auto front() noexcept -> T& { return at(0); }
+
+  auto pop() noexcept -> void
+  {
+    at(0).~T();
+    head_ = (head_ + 1) & mask_;
+    --size_;
+  }
+
+  NODISCARD auto size() const noexcept -> std::size_t { return size_; }
+  NODISCARD auto empty() const noexcept -> bool { return size_ == 0; }
+  NODISCARD auto capacity() const noexcept -> std::size_t { return slots_ ? mask_ + 1 : 0; }
+
+private:
+  auto at(std::size_t i) noexcept -> T& { return slots_[(head_ + i) & mask_].value; }
+
+  // Elements are moved if that cannot throw, and copied otherwise, so that a
+  // failure leaves the ring untouched.
+  auto reallocate(std::size_t capacity) -> void
+  {
+    std::unique_ptr<slot<T>[]> slots{new slot<T>[capacity]};
+    auto i = std::size_t{0};
+    COOL_TRY {
+      for (; i < size_; ++i)
+        ::new (static_cast<void*>(&slots[i].value)) T(std::move_if_noexcept(at(i)));
+    } COOL_CATCH_ALL {
+      while (i > 0)
+        slots[--i].value.~T();
+      COOL_RETHROW;
+    }
+
+    for (i = 0; i < size_; ++i)
+      at(i).~T();
+
+    slots_ = std::move(slots);
+    mask_ = capacity - 1;
+    head_ = 0;
+  }
+
+  std::unique_ptr<slot<T>[]> slots_;
+  std::size_t mask_ = 0;
+  std::size_t head_ = 0;
+  std::size_t size_ = 0;
+};
+
+// Binary max-heap that breaks ties by insertion order.  Each element carries
+// a sequence number, so equivalent elements come out first-in first-out.
+template <typename T, typename Compare> class heap
+{
+public:
+  auto reserve(std::size_t n) -> void { entries_.reserve(n); }
+
+  template <typename... Args> auto emplace(Args&&... args) -> void
+  {
+    entries_.emplace_back(next_++, std::forward<Args>(args)...);
+    sift_up(entries_.size() - 1);
+  }
+
+  template <typename U> auto push(U&& value) -> void { emplace(std::forward<U>(value)); }
+
+  auto front() noexcept -> T& { return entries_.front().value; }
+
+  // The front element may have been moved from; it is never compared again.
+  auto pop() -> void
+  {
+    if (entries_.size() > 1)
+      entries_.front() = std::move(entries_.back());
+    entries_.pop_back();
+    if (!entries_.empty())
+      sift_down(0);
+  }
+
+  NODISCARD auto size() const noexcept -> std::size_t { return entries_.size(); }
+  NODISCARD auto empty() const noexcept -> bool { return entries_.empty(); }
+
+private:
+  struct entry {
+    template <typename... Args> entry(std::uint64_t seq, Args&&... args) : seq{seq}, value(std::forward<Args>(args)...) {}
+
+    std::uint64_t seq;
+    T value;
+  };
+
+  auto before(const entry& a, const entry& b) const -> bool
+  {
+    if (compare_(b.value, a.value))
+      return true;
+    return !compare_(a.value, b.value) && a.seq < b.seq;
+  }
+
+  auto sift_up(std::size_t i) -> void
+  {
+    while (i > 0) {
+      const auto parent = (i - 1) / 2;
+      if (!before(entries_[i], entries_[parent]))
+        break;
+      std::swap(entries_[i], entries_[parent]);
+      i = parent;
+    }
+  }
+
+  auto sift_down(std::size_t i) -> void
+  {
+    const auto n = entries_.size();
+    while (true) {
+      auto first = i;
+      const auto left = 2 * i + 1, right = left + 1;
+      if (left < n && before(entries_[left], entries_[first]))
+        first = left;
+      if (right < n && before(entries_[right], entries_[first]))
+        first = right;
+      if (first == i)
+        break;
+      std::swap(entries_[i], entries_[first]);
+      i = first;
+    }
+  }
+
+  std::vector<entry> entries_;
+  std::uint64_t next_ = 0;
+  Compare compare_;
+};
+
+// One FIFO ring per priority level.  Levels are scanned from the first
+// non-empty one, which is tracked as elements come and go.
+template <typename T, std::size_t Levels, typename LevelOf> class buckets
+{
+public:
+  // Any level may have to hold the whole buffer.
+  auto reserve(std::size_t n) -> void
+  {
+    for (auto& level : levels_)
+      level.reserve(n);
+  }
+
+  template <typename... Args> auto emplace(Args&&... args) -> void
+  {
+    auto value = T(std::forward<Args>(args)...);
+    push(std::move(value));
+  }
+
+  auto emplace(const T& value) -> void { push(value); }
+  auto emplace(T&& value) -> void { push(std::move(value)); }
+
+  template <typename U> auto push(U&& value) -> void
+  {
+    const auto level = std::min(static_cast<std::size_t>(level_of_(static_cast<const T&>(value))), Levels - 1);
+    levels_[level].push(std::forward<U>(value));
+    top_ = std::min(top_, level);
+    ++size_;
+  }
+
+  auto front() noexcept -> T& { return levels_[top_].front(); }
+
+  auto pop() noexcept -> void
+  {
+    levels_[top_].pop();
+    --size_;
+    while (top_ < Levels && levels_[top_].empty())
+      ++top_;
+  }
+
+  NODISCARD auto size() const noexcept -> std::size_t { return size_; }
+  NODISCARD auto empty() const noexcept -> bool { return size_ == 0; }
+
+private:
+  ring<T> levels_[Levels];
+  std::size_t top_ = Levels;
+  std::size_t size_ = 0;
+  LevelOf level_of_;
+};
+
+// Wakes a thread blocked in `cool::select`.  Channels keep a list of the
+// selectors waiting on them and signal each one when their readiness changes.
+class selector
+{
+public:
+  auto signal() noexcept -> void
+  {
+    std::lock_guard<std::mutex> l{mutex_};
+    signaled_ = true;
+    cv_.notify_one();
+  }
+
+  auto wait() -> void
+  {
+    auto l = std::unique_lock<std::mutex>{mutex_};
+    cv_.wait(l, [this] { return signaled_; });
+    signaled_ = false;
+  }
+
+  template <typename Clock, typename Duration> auto wait_until(const std::chrono::time_point<Clock, Duration>& time) -> bool
+  {
+    auto l = std::unique_lock<std::mutex>{mutex_};
+    if (!cv_.wait_until(l, time, [this] { return signaled_; }))
+      return false;
+    signaled_ = false;
+    return true;
+  }
+
+private:
+  bool signaled_ = false;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+};
+
+// Must be guarded by the owner's mutex.
+class selector_list
+{
+public:
+  auto add(selector* s) -> void { selectors_.push_back(s); }
+
+  auto remove(selector* s) noexcept -> void
+  {
+    for (auto it = selectors_.begin(); it != selectors_.end(); ++it) {
+      if (*it == s) {
+        selectors_.erase(it);
+        return;
+      }
+    }
+  }
+
+  auto signal() noexcept -> void
+  {
+    for (auto* s : selectors_)
+      s->signal();
+  }
+
+private:
+  std::vector<selector*> selectors_;
+};
+
+// Spin-then-park notification for lock-free states.
+//
+// Waiters first poll the predicate for a short while and only then park on a
+// condition variable.  Notifiers skip the mutex entirely unless someone is
+// parked or a selector is watching, so the uncontended path is a fence and a
+// relaxed load.
+class parking_event
+{
+public:
+  explicit parking_event(wait_strategy strategy) noexcept : strategy_{strategy} {}
+
+  template <typename P> auto wait(P ready) -> void
+  {
+    if (strategy_.spin(ready))
+      return;
+
+    waiters_.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    {
+      auto l = std::unique_lock<std::mutex>{mutex_};
+      cv_.wait(l, ready);
+    }
+    waiters_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  template <typename Clock, typename Duration, typename P>
+  auto wait_until(const std::chrono::time_point<Clock, Duration>& time, P ready) -> bool
+  {
+    if (strategy_.spin_until(time, ready))
+      return true;
+    if (!strategy_.parks())
+      return false;
+
+    waiters_.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto result = false;
+    {
+      auto l = std::unique_lock<std::mutex>{mutex_};
+      result = cv_.wait_until(l, time, ready);
+    }
+    waiters_.fetch_sub(1, std::memory_order_relaxed);
+    return result;
+  }
+
+  auto notify_one() noexcept -> void
+  {
+    if (has_waiters()) {
+      {
+        std::lock_guard<std::mutex> l{mutex_};
+        selectors_.signal();
+      }
+      cv_.notify_one();
+    }
+  }
+
+  auto notify_all() noexcept -> void
+  {
+    if (has_waiters()) {
+      {
+        std::lock_guard<std::mutex> l{mutex_};
+        selectors_.signal();
+      }
+      cv_.notify_all();
+    }
+  }
+
+  auto watch(selector* s) -> void
+  {
+    waiters_.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::lock_guard<std::mutex> l{mutex_};
+    selectors_.add(s);
+  }
+
+  auto unwatch(selector* s) noexcept -> void
+  {
+    {
+      std::lock_guard<std::mutex> l{mutex_};
+      selectors_.remove(s);
+    }
+    waiters_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  // Wakes as many waiters as elements became available.
+  auto notify(std::size_t count) noexcept -> void
+  {
+    if (count == 1)
+      notify_one();
+    else if (count > 1)
+      notify_all();
+  }
+
+private:
+  auto has_waiters() noexcept -> bool
+  {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return waiters_.load(std::memory_order_relaxed) > 0;
+  }
+
+  const wait_strategy strategy_;
+  std::atomic<std::size_t> waiters_{0};
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  selector_list selectors_;
+};
+
+// Waiting policies.  A policy is invoked with the predicate that unblocks an
+// operation, either on a parking event or on a condition variable and its
+// lock, and returns whether the predicate holds afterwards.  How the thread
+// waits is up to the strategy of the event, or the one given with the lock.
+struct wait_forever {
+  template <typename P> auto operator()(parking_event& event, P ready) const -> bool
+  {
+    event.wait(ready);
+    return true;
+  }
+
+  template <typename P>
+  auto operator()(const wait_strategy& strategy, std::condition_variable& cv, std::unique_lock<std::mutex>& l, P ready) const
+    -> bool
+  {
+    strategy.wait(cv, l, ready);
+    return true;
+  }
+};
+
+template <typename Clock, typename Duration> struct wait_until_time {
+  std::chrono::time_point<Clock, Duration> time;
+
+  template <typename P> auto operator()(parking_event& event, P ready) const -> bool { return event.wait_until(time, ready); }
+
+  template <typename P>
+  auto operator()(const wait_strategy& strategy, std::condition_variable& cv, std::unique_lock<std::mutex>& l, P ready) const
+    -> bool
+  {
+    return strategy.wait_until(cv, l, time, ready);
+  }
+};
+
+struct no_wait {
+  template <typename P> auto operator()(parking_event&, P ready) const -> bool { return ready(); }
+
+  template <typename P>
+  auto operator()(const wait_strategy&, std::condition_variable&, std::unique_lock<std::mutex>&, P ready) const -> bool
+  {
+    return ready();
+  }
+};
+
+template <typename T, typename Backend> class channel_state;
+
+// Channel state guarding a `Buffer` with a mutex; the buffer decides the order
+// in which elements are received.
+//
+// Senders wait on `not_full_` and receivers on `not_empty_`, so a transfer
+// only ever wakes the other side.  Waiters are counted, and notifications are
+// skipped when nobody is waiting and limited to as many threads as can proceed.
+//
+// Bounded channels allocate their whole buffer upfront; unbounded ones grow it
+// as needed and keep the largest size reached.
+template <typename T, typename Buffer> class locked_state
+{
+public:
+  explicit locked_state(std::size_t buffer_size, wait_strategy strategy) : buffer_size_{buffer_size}, strategy_{strategy}
+  {
+    if (buffer_size != std::numeric_limits<std::size_t>::max())
+      buffer_.reserve(buffer_size);
+  }
+
+  template <typename U, typename W> auto push(U&& value, W wait) -> channel_status
+  {
+    return emplace(wait, std::forward<U>(value));
+  }
+
+  template <typename W, typename... Args> auto emplace(W wait, Args&&... args) -> channel_status
+  {
+    auto receivers = std::size_t{0};
+    {
+      auto l = lock();
+      wait_on(wait, not_full_, senders_, l, [this] { return closed_ || has_space(); });
+
+      if (closed_)
+        return channel_status::closed;
+
+      if (!has_space())
+        return channel_status::timeout;
+
+      buffer_.emplace(std::forward<Args>(args)...);
+      readable_.signal();
+      receivers = receivers_;
+    }
+    wake(not_empty_, receivers, 1);
+    return channel_status::ok;
+  }
+
+  template <typename F, typename W> auto pop(F&& f, W wait) -> channel_status
+  {
+    auto senders = std::size_t{0};
+    {
+      auto l = lock();
+      wait_on(wait, not_empty_, receivers_, l, [this] { return closed_ || has_value(); });
+
+      if (!has_value())
+        return closed_ ? channel_status::closed : channel_status::timeout;
+
+      f(std::move(buffer_.front()));
+      buffer_.pop();
+      writable_.signal();
+      senders = senders_;
+    }
+    wake(not_full_, senders, 1);
+    return channel_status::ok;
+  }
+
+  template <typename It> auto push_n(It first, std::size_t n) -> std::size_t
+  {
+    auto pushed = std::size_t{0};
+    while (pushed < n) {
+      auto batch = std::size_t{0};
+      auto receivers = std::size_t{0};
+      {
+        auto l = lock();
+        wait_on(wait_forever{}, not_full_, senders_, l, [this] { return closed_ || has_space(); });
+
+        if (closed_)
+          return pushed;
+
+        COOL_TRY {
+          for (; pushed + batch < n && has_space(); ++batch, ++first)
+            buffer_.push(*first);
+        } COOL_CATCH_ALL {
+          readable_.signal();
+          receivers = receivers_;
+          l.unlock();
+          wake(not_empty_, receivers, batch);
+          COOL_RETHROW;
+        }
+        readable_.signal();
+        receivers = receivers_;
+      }
+      wake(not_empty_, receivers, batch);
+      pushed += batch;
+    }
+    return pushed;
+  }
+
+  template <typename F> auto pop_n(F&& f, std::size_t n) -> std::size_t
+  {
+    auto popped = std::size_t{0};
+    auto senders = std::size_t{0};
+    {
+      auto l = lock();
+      wait_on(wait_forever{}, not_empty_, receivers_, l, [this] { return closed_ || has_value(); });
+
+      COOL_TRY {
+        for (; popped < n && has_value(); ++popped) {
+          f(std::move(buffer_.front()));
+          buffer_.pop();
+        }
+      } COOL_CATCH_ALL {
+        writable_.signal();
+        senders = senders_;
+        l.unlock();
+        wake(not_full_, senders, popped);
+        COOL_RETHROW;
+      }
+      if (popped > 0)
+        writable_.signal();
+      senders = senders_;
+    }
+    wake(not_full_, senders, popped);
+    return popped;
+  }
+
+  auto close() noexcept -> void
+  {
+    auto senders = std::size_t{0}, receivers = std::size_t{0};
+    {
+      auto l = lock();
+      closed_ = true;
+      readable_.signal();
+      writable_.signal();
+      senders = senders_;
+      receivers = receivers_;
+    }
+    wake(not_full_, senders, senders);
+    wake(not_empty_, receivers, receivers);
+  }
+
+  NODISCARD auto is_closed() const noexcept -> bool
+  {
+    auto l = lock();
+    return closed_;
+  }
+
+  auto buffer_size(std::size_t size) noexcept -> void
+  {
+    auto senders = std::size_t{0}, space = std::size_t{0};
+    {
+      auto l = lock();
+      buffer_size_ = size;
+      writable_.signal();
+      senders = senders_;
+      space = size > buffer_.size() ? size - buffer_.size() : 0;
+    }
+    wake(not_full_, senders, space);
+  }
+
+  NODISCARD auto buffer_size() const noexcept -> std::size_t
+  {
+    auto l = lock();
+    return buffer_size_;
+  }
+
+  auto watch(selector* s, bool writable) -> void
+  {
+    auto l = lock();
+    (writable ? writable_ : readable_).add(s);
+  }
+
+  auto unwatch(selector* s, bool writable) noexcept -> void
+  {
+    auto l = lock();
+    (writable ? writable_ : readable_).remove(s);
+  }
+
+private:
+  NODISCARD auto has_space() const noexcept -> bool { return buffer_.size() < buffer_size_; }
+  NODISCARD auto has_value() const noexcept -> bool { return !buffer_.empty(); }
+
+  template <typename W, typename P>
+  auto wait_on(const W& wait, std::condition_variable& cv, std::size_t& waiters, std::unique_lock<std::mutex>& l, P ready)
+    -> void
+  {
+    if (ready())
+      return;
+
+    ++waiters;
+    wait(strategy_, cv, l, ready);
+    --waiters;
+  }
+
+  // Wakes up to `count` of the `waiters` counted under the lock.
+  static auto wake(std::condition_variable& cv, std::size_t waiters, std::size_t count) noexcept -> void
+  {
+    if (waiters == 0 || count == 0)
+      return;
+
+    if (count >= waiters) {
+      cv.notify_all();
+    } else {
+      for (auto i = std::size_t{0}; i < count; ++i)
+        cv.notify_one();
+    }
+  }
+
+  NODISCARD auto lock() const noexcept -> std::unique_lock<std::mutex> { return std::unique_lock<std::mutex>{mutex_}; }
+
+  std::size_t buffer_size_;
+  bool closed_ = false;
+
+  const wait_strategy strategy_;
+  Buffer buffer_;
+  mutable std::mutex mutex_;
+
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+  std::size_t senders_ = 0;
+  std::size_t receivers_ = 0;
+
+  selector_list readable_;
+  selector_list writable_;
+};
+
+template <typename T> class channel_state<T, mutex_backend> : public locked_state<T, ring<T>>
+{
+public:
+  explicit channel_state(std::size_t buffer_size = std::numeric_limits<std::size_t>::max(),
+                         wait_strategy strategy = wait_strategy::block())
+    : locked_state<T, ring<T>>{buffer_size, strategy}
+  {
+  }
+
+  explicit channel_state(wait_strategy strategy) : channel_state{std::numeric_limits<std::size_t>::max(), strategy} {}
+};
+
+template <typename T, typename Compare>
+class channel_state<T, priority_backend<Compare>>
+  : public locked_state<T, heap<T, typename std::conditional<std::is_void<Compare>::value, std::less<T>, Compare>::type>>
+{
+  using base = locked_state<T, heap<T, typename std::conditional<std::is_void<Compare>::value, std::less<T>, Compare>::type>>;
+
+public:
+  explicit channel_state(std::size_t buffer_size = std::numeric_limits<std::size_t>::max(),
+                         wait_strategy strategy = wait_strategy::block())
+    : base{buffer_size, strategy}
+  {
+  }
+
+  explicit channel_state(wait_strategy strategy) : channel_state{std::numeric_limits<std::size_t>::max(), strategy} {}
+};
+
+template <typename T, std::size_t Levels, typename LevelOf>
+class channel_state<T, bucket_backend<Levels, LevelOf>> : public locked_state<T, buckets<T, Levels, LevelOf>>
+{
+public:
+  explicit channel_state(std::size_t buffer_size = std::numeric_limits<std::size_t>::max(),
+                         wait_strategy strategy = wait_strategy::block())
+    : locked_state<T, buckets<T, Levels, LevelOf>>{buffer_size, strategy}
+  {
+  }
+
+  explicit channel_state(wait_strategy strategy) : channel_state{std::numeric_limits<std::size_t>::max(), strategy} {}
+};
+
+// Lamport ring buffer with monotonic head/tail indices.  Each side keeps a
+// cached copy of the other side's index on its own cache line, so the shared
+// indices are only reloaded when the ring looks full or empty.
+template <typename T> class channel_state<T, spsc_backend>
+{
+public:
+  explicit channel_state(std::size_t buffer_size, wait_strategy strategy = wait_strategy::spin_then_block())
+    : size_{buffer_size > 0 ? buffer_size : 1},
+      mask_{ceil_pow2(size_) - 1},
+      slots_{new slot<T>[mask_ + 1]},
+      not_full_{strategy},
+      not_empty_{strategy}
+  {
+  }
+
+  channel_state(const channel_state&) = delete;
+  auto operator=(const channel_state&) -> channel_state& = delete;
+
+  ~channel_state()
+  {
+    const auto tail = tail_.load(std::memory_order_relaxed);
+    for (auto i = head_.load(std::memory_order_relaxed); i != tail; ++i)
+      at(i).~T();
+  }
+
+  template <typename U, typename W> auto push(U&& value, W wait) -> channel_status
+  {
+    return emplace(wait, std::forward<U>(value));
+  }
+
+  template <typename W, typename... Args> auto emplace(W wait, Args&&... args) -> channel_status
+  {
+    const auto tail = tail_.load(std::memory_order_relaxed);
+    const auto result = wait_space(tail, wait);
+    if (result != channel_status::ok)
+      return result;
+
+    ::new (static_cast<void*>(&at(tail))) T(std::forward<Args>(args)...);
+    publish(tail, 1);
+    return channel_status::ok;
+  }
+
+  template <typename F, typename W> auto pop(F&& f, W wait) -> channel_status
+  {
+    const auto head = head_.load(std::memory_order_relaxed);
+    if (!has_value(head)) {
+      wait(not_empty_, [this, head] { return is_closed() || has_value(head); });
+      if (!has_value(head)) {
+        // Values sent before closing are visible once the closing is.
+        if (!is_closed())
+          return channel_status::timeout;
+        if (!has_value(head))
+          return channel_status::closed;
+      }
+    }
+
+    consume(head, 1, f);
+    return channel_status::ok;
+  }
+
+  // The whole free (resp. filled) part of the ring is transferred with a
+  // single index update and a single notification.
+  template <typename It> auto push_n(It first, std::size_t n) -> std::size_t
+  {
+    auto pushed = std::size_t{0};
+    while (pushed < n) {
+      const auto tail = tail_.load(std::memory_order_relaxed);
+      if (wait_space(tail, wait_forever{}) != channel_status::ok)
+        return pushed;
+
+      const auto batch = std::min(n - pushed, size_ - (tail - head_cache_));
+      auto i = std::size_t{0};
+      COOL_TRY {
+        for (; i < batch; ++i, ++first)
+          ::new (static_cast<void*>(&at(tail + i))) T(*first);
+      } COOL_CATCH_ALL {
+        publish(tail, i);
+        COOL_RETHROW;
+      }
+      publish(tail, batch);
+      pushed += batch;
+    }
+    return pushed;
+  }
+
+  template <typename F> auto pop_n(F&& f, std::size_t n) -> std::size_t
+  {
+    const auto head = head_.load(std::memory_order_relaxed);
+    if (!has_value(head)) {
+      not_empty_.wait([this, head] { return is_closed() || has_value(head); });
+      if (!has_value(head))
+        return 0;
+    }
+
+    const auto batch = std::min(n, tail_cache_ - head);
+    consume(head, batch, f);
+    return batch;
+  }
+
+  auto close() noexcept -> void
+  {
+    closed_.store(true, std::memory_order_release);
+    not_full_.notify_all();
+    not_empty_.notify_all();
+  }
+
+  NODISCARD auto is_closed() const noexcept -> bool { return closed_.load(std::memory_order_acquire); }
+
+  NODISCARD auto buffer_size() const noexcept -> std::size_t { return size_; }
+
+  auto watch(selector* s, bool writable) -> void { (writable ? not_full_ : not_empty_).watch(s); }
+
+  auto unwatch(selector* s, bool writable) noexcept -> void { (writable ? not_full_ : not_empty_).unwatch(s); }
+
+private:
+  auto at(std::size_t i) noexcept -> T& { return slots_[i & mask_].value; }
+
+  // Producer side.
+  auto has_space(std::size_t tail) noexcept -> bool
+  {
+    if (tail - head_cache_ < size_)
+      return true;
+    head_cache_ = head_.load(std::memory_order_acquire);
+    return tail - head_cache_ < size_;
+  }
+
+  // Consumer side.
+  auto has_value(std::size_t head) noexcept -> bool
+  {
+    if (head != tail_cache_)
+      return true;
+    tail_cache_ = tail_.load(std::memory_order_acquire);
+    return head != tail_cache_;
+  }
+
+  template <typename W> auto wait_space(std::size_t tail, W wait) -> channel_status
+  {
+    if (!has_space(tail))
+      wait(not_full_, [this, tail] { return is_closed() || has_space(tail); });
+
+    if (is_closed())
+      return channel_status::closed;
+    return has_space(tail) ? channel_status::ok : channel_status::timeout;
+  }
+
+  auto publish(std::size_t tail, std::size_t count) noexcept -> void
+  {
+    if (count == 0)
+      return;
+    tail_.store(tail + count, std::memory_order_release);
+    not_empty_.notify_one();
+  }
+
+  template <typename F> auto consume(std::size_t head, std::size_t count, F& f) -> void
+  {
+    // Consumed slots are released even if `f` throws; the throwing element stays.
+    struct release {
+      channel_state* self;
+      std::size_t head;
+      std::size_t count;
+      ~release()
+      {
+        if (count == 0)
+          return;
+        self->head_.store(head + count, std::memory_order_release);
+        self->not_full_.notify_one();
+      }
+    } guard{this, head, 0};
+
+    for (; guard.count < count; ++guard.count) {
+      auto& value = at(head + guard.count);
+      f(std::move(value));
+      value.~T();
+    }
+  }
+
+  const std::size_t size_;
+  const std::size_t mask_;
+  const std::unique_ptr<slot<T>[]> slots_;
+  std::atomic<bool> closed_{false};
+
+  char pad0_[cache_line_size];
+  std::atomic<std::size_t> head_{0};
+  std::size_t tail_cache_ = 0;
+
+  char pad1_[cache_line_size];
+  std::atomic<std::size_t> tail_{0};
+  std::size_t head_cache_ = 0;
+
+  char pad2_[cache_line_size];
+  parking_event not_full_;
+  parking_event not_empty_;
+};
+
+// Bounded MPMC queue after Dmitry Vyukov.  A slot whose sequence equals the
+// enqueue position is free; one whose sequence equals the dequeue position
+// plus one holds a value.  Producers and consumers claim positions with a CAS
+// and then publish the slot by bumping its sequence.
+template <typename T> class channel_state<T, mpmc_backend>
+{
+  static_assert(std::is_nothrow_move_constructible<T>::value, "T must be nothrow move constructible");
+
+public:
+  explicit channel_state(std::size_t buffer_size, wait_strategy strategy = wait_strategy::spin_then_block())
+    : mask_{ceil_pow2(buffer_size > 2 ? buffer_size : 2) - 1}, cells_{new cell[mask_ + 1]}, not_full_{strategy},
+      not_empty_{strategy}
+  {
+    for (std::size_t i = 0; i <= mask_; ++i)
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  channel_state(const channel_state&) = delete;
+  auto operator=(const channel_state&) -> channel_state& = delete;
+
+  ~channel_state()
+  {
+    const auto tail = enqueue_pos_.load(std::memory_order_relaxed);
+    for (auto i = dequeue_pos_.load(std::memory_order_relaxed); i != tail; ++i)
+      cells_[i & mask_].storage.value.~T();
+  }
+
+  template <typename U, typename W> auto push(U&& value, W wait) -> channel_status
+  {
+    return emplace(wait, std::forward<U>(value));
+  }
+
+  template <typename W, typename... Args> auto emplace(W wait, Args&&... args) -> channel_status
+  {
+    return emplace_value(wait, std::is_nothrow_constructible<T, Args&&...>{}, std::forward<Args>(args)...);
+  }
+
+  template <typename F, typename W> auto pop(F&& f, W wait) -> channel_status
+  {
+    while (true) {
+      if (pop_some(f, 1) > 0)
+        return channel_status::ok;
+
+      // Values sent before closing are visible once the closing is.
+      const auto closed = is_closed();
+      if (has_value())
+        cpu_relax(); // a producer claimed a slot but has not published it yet
+      else if (closed)
+        return channel_status::closed;
+      else if (!wait(not_empty_, [this] { return is_closed() || has_value(); }))
+        return channel_status::timeout;
+    }
+  }
+
+  template <typename It> auto push_n(It first, std::size_t n) -> std::size_t
+  {
+    return push_n_values(first, n, std::is_nothrow_constructible<T, decltype(*first)>{});
+  }
+
+  template <typename F> auto pop_n(F&& f, std::size_t n) -> std::size_t
+  {
+    while (true) {
+      if (const auto count = pop_some(f, n))
+        return count;
+
+      const auto closed = is_closed();
+      if (has_value())
+        cpu_relax();
+      else if (closed)
+        return 0;
+      else
+        not_empty_.wait([this] { return is_closed() || has_value(); });
+    }
+  }
+
+  auto close() noexcept -> void
+  {
+    closed_.store(true, std::memory_order_release);
+    not_full_.notify_all();
+    not_empty_.notify_all();
+  }
+
+  NODISCARD auto is_closed() const noexcept -> bool { return closed_.load(std::memory_order_acquire); }
+
+  NODISCARD auto buffer_size() const noexcept -> std::size_t { return mask_ + 1; }
+
+  auto watch(selector* s, bool writable) -> void { (writable ? not_full_ : not_empty_).watch(s); }
+
+  auto unwatch(selector* s, bool writable) noexcept -> void { (writable ? not_full_ : not_empty_).unwatch(s); }
+
+private:
+  struct cell {
+    std::atomic<std::size_t> sequence;
+    slot<T> storage;
+  };
+
+  struct claimed {
+    std::size_t pos;
+    std::size_t count;
+  };
+
+  // Claims up to `max` consecutive positions whose slots are ready, i.e.,
+  // whose sequence equals the position plus `offset` (0 for producers and 1
+  // for consumers).  No other thread can take a checked slot without first
+  // moving `position`, so a successful CAS makes the whole run ours.
+  auto claim(std::atomic<std::size_t>& position, std::size_t offset, std::size_t max) noexcept -> claimed
+  {
+    auto pos = position.load(std::memory_order_relaxed);
+    while (true) {
+      auto count = std::size_t{0};
+      while (count < max && cells_[(pos + count) & mask_].sequence.load(std::memory_order_acquire) == pos + count + offset)
+        ++count;
+
+      if (count > 0) {
+        if (position.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed))
+          return {pos, count};
+        continue;
+      }
+
+      const auto seq = cells_[pos & mask_].sequence.load(std::memory_order_acquire);
+      if (static_cast<std::ptrdiff_t>(seq - (pos + offset)) < 0)
+        return {pos, 0};
+      pos = position.load(std::memory_order_relaxed);
+    }
+  }
+
+  // Constructing `T` might throw after a slot is claimed, which would leave a
+  // hole in the ring.  In that case the value is built beforehand and moved.
+  // Arguments are only forwarded once, when a slot has been claimed.
+  template <typename W, typename... Args> auto emplace_value(W wait, std::true_type, Args&&... args) -> channel_status
+  {
+    while (true) {
+      if (is_closed())
+        return channel_status::closed;
+
+      if (emplace_one(std::forward<Args>(args)...))
+        return channel_status::ok;
+
+      if (has_space())
+        cpu_relax(); // a consumer claimed a slot but has not released it yet
+      else if (!wait(not_full_, [this] { return is_closed() || has_space(); }))
+        return channel_status::timeout;
+    }
+  }
+
+  template <typename W, typename... Args> auto emplace_value(W wait, std::false_type, Args&&... args) -> channel_status
+  {
+    if (is_closed())
+      return channel_status::closed;
+
+    auto tmp = T(std::forward<Args>(args)...);
+    return emplace_value(wait, std::true_type{}, std::move(tmp));
+  }
+
+  template <typename It> auto push_n_values(It first, std::size_t n, std::true_type) -> std::size_t
+  {
+    auto pushed = std::size_t{0};
+    while (pushed < n) {
+      if (is_closed())
+        return pushed;
+
+      if (const auto count = push_some(first, n - pushed)) {
+        pushed += count;
+        continue;
+      }
+
+      if (has_space())
+        cpu_relax();
+      else
+        not_full_.wait([this] { return is_closed() || has_space(); });
+    }
+    return pushed;
+  }
+
+  template <typename It> auto push_n_values(It first, std::size_t n, std::false_type) -> std::size_t
+  {
+    for (auto i = std::size_t{0}; i < n; ++i, ++first)
+      if (push(*first, wait_forever{}) != channel_status::ok)
+        return i;
+    return n;
+  }
+
+  template <typename... Args> auto emplace_one(Args&&... args) -> bool
+  {
+    const auto c = claim(enqueue_pos_, 0, 1);
+    if (c.count == 0)
+      return false;
+
+    auto& cell = cells_[c.pos & mask_];
+    ::new (static_cast<void*>(&cell.storage.value)) T(std::forward<Args>(args)...);
+    cell.sequence.store(c.pos + 1, std::memory_order_release);
+    not_empty_.notify_one();
+    return true;
+  }
+
+  template <typename It> auto push_some(It& first, std::size_t max) -> std::size_t
+  {
+    const auto c = claim(enqueue_pos_, 0, max);
+    for (auto i = std::size_t{0}; i < c.count; ++i, ++first) {
+      auto& cell = cells_[(c.pos + i) & mask_];
+      ::new (static_cast<void*>(&cell.storage.value)) T(*first);
+      cell.sequence.store(c.pos + i + 1, std::memory_order_release);
+    }
+    not_empty_.notify(c.count);
+    return c.count;
+  }
+
+  template <typename F> auto pop_some(F& f, std::size_t max) -> std::size_t
+  {
+    // Claimed slots are released even if `f` throws; the remaining elements are then lost.
+    struct release {
+      channel_state* self;
+      claimed c;
+      ~release()
+      {
+        for (auto i = std::size_t{0}; i < c.count; ++i) {
+          auto& cell = self->cells_[(c.pos + i) & self->mask_];
+          cell.storage.value.~T();
+          cell.sequence.store(c.pos + i + self->mask_ + 1, std::memory_order_release);
+        }
+        self->not_full_.notify(c.count);
+      }
+    } guard{this, claim(dequeue_pos_, 1, max)};
+
+    for (auto i = std::size_t{0}; i < guard.c.count; ++i)
+      f(std::move(cells_[(guard.c.pos + i) & mask_].storage.value));
+    return guard.c.count;
+  }
+
+  NODISCARD auto has_value() const noexcept -> bool
+  {
+    return enqueue_pos_.load(std::memory_order_acquire) != dequeue_pos_.load(std::memory_order_acquire);
+  }
+
+  NODISCARD auto has_space() const noexcept -> bool
+  {
+    return enqueue_pos_.load(std::memory_order_acquire) - dequeue_pos_.load(std::memory_order_acquire) <= mask_;
+  }
+
+  const std::size_t mask_;
+  const std::unique_ptr<cell[]> cells_;
+  std::atomic<bool> closed_{false};
+
+  char pad0_[cache_line_size];
+  std::atomic<std::size_t> enqueue_pos_{0};
+
+  char pad1_[cache_line_size];
+  std::atomic<std::size_t> dequeue_pos_{0};
+
+  char pad2_[cache_line_size];
+  parking_event not_full_;
+  parking_event not_empty_;
+};
+
+// Waiting policy that adds the time spent waiting to a counter.  Non-blocking
+// operations never wait, so they are not timed.
+template <typename W> struct timed_wait {
+  W wait;
+  std::atomic<std::uint64_t>* blocked;
+
+  template <typename... Args> auto operator()(Args&&... args) const -> bool
+  {
+    const auto start = std::chrono::steady_clock::now();
+    const auto result = wait(std::forward<Args>(args)...);
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    blocked->fetch_add(static_cast<std::uint64_t>(elapsed.count()), std::memory_order_relaxed);
+    return result;
+  }
+};
+
+template <typename W> auto timed(W wait, std::atomic<std::uint64_t>& blocked) -> timed_wait<W> { return {wait, &blocked}; }
+
+inline auto timed(no_wait wait, std::atomic<std::uint64_t>&) -> no_wait { return wait; }
+
+// Counts the operations that complete on the wrapped state.
+template <typename T, typename Backend> class channel_state<T, instrumented<Backend>> : public channel_state<T, Backend>
+{
+  using base = channel_state<T, Backend>;
+
+public:
+  template <typename... Args, typename = typename std::enable_if<std::is_constructible<base, Args&&...>::value>::type>
+  explicit channel_state(Args&&... args) : base(std::forward<Args>(args)...)
+  {
+  }
+
+  template <typename U, typename W> auto push(U&& value, W wait) -> channel_status
+  {
+    return emplace(wait, std::forward<U>(value));
+  }
+
+  template <typename W, typename... Args> auto emplace(W wait, Args&&... args) -> channel_status
+  {
+    const auto result = base::emplace(timed(wait, send_blocked_), std::forward<Args>(args)...);
+    if (result == channel_status::ok)
+      sent(1);
+    return result;
+  }
+
+  template <typename F, typename W> auto pop(F&& f, W wait) -> channel_status
+  {
+    const auto result = base::pop(std::forward<F>(f), timed(wait, receive_blocked_));
+    if (result == channel_status::ok)
+      receives_.fetch_add(1, std::memory_order_relaxed);
+    return result;
+  }
+
+  template <typename It> auto push_n(It first, std::size_t n) -> std::size_t
+  {
+    const auto count = base::push_n(first, n);
+    sent(count);
+    return count;
+  }
+
+  template <typename F> auto pop_n(F&& f, std::size_t n) -> std::size_t
+  {
+    const auto count = base::pop_n(std::forward<F>(f), n);
+    receives_.fetch_add(count, std::memory_order_relaxed);
+    return count;
+  }
+
+  auto close() noexcept -> void
+  {
+    closes_.fetch_add(1, std::memory_order_relaxed);
+    base::close();
+  }
+
+  NODISCARD auto stats() const noexcept -> channel_stats
+  {
+    const auto receives = receives_.load(std::memory_order_relaxed);
+    const auto sends = sends_.load(std::memory_order_relaxed);
+    return {sends,
+            receives,
+            sends > receives ? sends - receives : 0,
+            high_water_.load(std::memory_order_relaxed),
+            std::chrono::nanoseconds{send_blocked_.load(std::memory_order_relaxed)},
+            std::chrono::nanoseconds{receive_blocked_.load(std::memory_order_relaxed)},
+            closes_.load(std::memory_order_relaxed)};
+  }
+
+private:
+  auto sent(std::size_t count) noexcept -> void
+  {
+    if (count == 0)
+      return;
+
+    const auto sends = sends_.fetch_add(count, std::memory_order_relaxed) + count;
+    const auto receives = receives_.load(std::memory_order_relaxed);
+    const auto depth = sends > receives ? sends - receives : 0;
+
+    auto high_water = high_water_.load(std::memory_order_relaxed);
+    while (depth > high_water && !high_water_.compare_exchange_weak(high_water, depth, std::memory_order_relaxed)) {
+    }
+  }
+
+  std::atomic<std::uint64_t> sends_{0};
+  std::atomic<std::uint64_t> receives_{0};
+  std::atomic<std::uint64_t> high_water_{0};
+  std::atomic<std::uint64_t> send_blocked_{0};
+  std::atomic<std::uint64_t> receive_blocked_{0};
+  std::atomic<std::uint64_t> closes_{0};
+};
+
+} // namespace detail
+
+template <typename T, typename Backend = mutex_backend> class channel;
+template <typename T, typename Backend = mutex_backend> class ichannel;
+template <typename T, typename Backend = mutex_backend> class ochannel;
+class select;
+
+/// Input iterator over the values received from a channel.
+///
+/// Incrementing the iterator receives the next value, blocking if no data is available.
+/// Once the channel is closed and empty, the iterator compares equal to the end iterator.
+///
+/// \module Channel
+///
+/// \notes The iterator does not own the channel: the channel must outlive it.
+/// \notes Reaching the end of a closed channel does not throw.
+template <typename T, typename Backend = mutex_backend> class channel_iterator
 {
-  using std::invalid_argument::invalid_argument;
-};
+  friend class channel<T, Backend>;
 
-/// \exclude
-namespace detail
-{
+public:
+  using iterator_category = std::input_iterator_tag;
+  using value_type = T;
+  using difference_type = std::ptrdiff_t;
+  using pointer = T*;
+  using reference = T&;
 
-template <typename T> struct channel_state {
-  channel_state() = default;
-  explicit channel_state(std::size_t buffer_size) : buffer_size{buffer_size} {}
+  /// Constructs the end iterator.
+  channel_iterator() noexcept = default;
 
-  std::size_t buffer_size = std::numeric_limits<std::size_t>::max();
-  bool closed = false;
+  auto operator*() -> T& { return *value_; }
+  auto operator->() -> T* { return &*value_; }
 
-  std::queue<T> buffer;
-  std::condition_variable cv;
-  std::mutex mutex;
-};
+  auto operator++() -> channel_iterator&
+  {
+    value_.reset();
+    if (state_->pop([this](T&& v) { value_.emplace(std::move(v)); }, detail::wait_forever{}) != channel_status::ok)
+      state_ = nullptr;
+    return *this;
+  }
 
-} // namespace detail
+  /// \exclude
+  struct proxy {
+    T value;
+    auto operator*() -> T& { return value; }
+  };
+
+  /// \exclude
+  auto operator++(int) -> proxy
+  {
+    auto p = proxy{std::move(*value_)};
+    ++*this;
+    return p;
+  }
+
+  /// \group comparison Checks whether or not both iterators are at the end.
+  auto operator==(const channel_iterator& other) const noexcept -> bool { return state_ == other.state_; }
+
+  /// \group comparison
+  auto operator!=(const channel_iterator& other) const noexcept -> bool { return state_ != other.state_; }
+
+private:
+  explicit channel_iterator(detail::channel_state<T, Backend>* state) : state_{state} { ++*this; }
 
-template <typename T> class ichannel;
-template <typename T> class ochannel;
+  detail::channel_state<T, Backend>* state_ = nullptr;
+  received<T> value_;
+};
 
 /// Channels are pipes that can receive and send data among different threads.
 ///
+/// The `Backend` parameter selects how elements are buffered; see
+/// [cool::mutex_backend]() (default), [cool::spsc_backend](), [cool::mpmc_backend](),
+/// and the priority backends [cool::priority_backend]() and [cool::bucket_backend]().
+/// Any of them can be wrapped in [cool::instrumented]() to collect statistics.
+///
 /// \module Channel
 ///
 /// \notes After constructed, following copies refer to the same channel.
-template <typename T> class channel
+template <typename T, typename Backend> class channel
 {
-  friend class ichannel<T>;
-  friend class ochannel<T>;
+  friend class ichannel<T, Backend>;
+  friend class ochannel<T, Backend>;
+  friend class select;
 
 public:
+  using iterator = channel_iterator<T, Backend>;
+
   /// \group constructors Constructors
   ///
   /// Constructs a new channel
@@ -91,10 +1627,30 @@ public:
   /// (1) with a buffer of virtually infinity size.
   ///
   /// (2) with a buffer of size `buffer_size`.
-  channel() : state_{std::make_shared<detail::channel_state<T>>()} {}
+  ///
+  /// (3) and (4) as (1) and (2), where blocked calls wait according to `strategy`.
+  ///
+  /// \notes With (2) and (4), room for `buffer_size` elements is allocated upfront.
+  /// \notes Bounded backends, such as [cool::spsc_backend](), require (2) or (4).
+  /// \notes By default, mutex-based backends use [cool::wait_strategy]() `block`, and
+  ///        lock-free ones `spin_then_block`.
+  channel() : state_{std::make_shared<detail::channel_state<T, Backend>>()} {}
+
+  /// \group constructors
+  channel(std::size_t buffer_size) : state_{std::make_shared<detail::channel_state<T, Backend>>(buffer_size)} {}
+
+  /// \group constructors
+  template <typename B = Backend,
+            typename = typename std::enable_if<std::is_constructible<detail::channel_state<T, B>, wait_strategy>::value>::type>
+  explicit channel(wait_strategy strategy) : state_{std::make_shared<detail::channel_state<T, Backend>>(strategy)}
+  {
+  }
 
   /// \group constructors
-  channel(std::size_t buffer_size) : state_{std::make_shared<detail::channel_state<T>>(buffer_size)} {}
+  channel(std::size_t buffer_size, wait_strategy strategy)
+    : state_{std::make_shared<detail::channel_state<T, Backend>>(buffer_size, strategy)}
+  {
+  }
 
   /// \exclude
   channel(const channel&) noexcept = default;
@@ -116,33 +1672,152 @@ public:
   /// \notes `send` throws [cool::closed_channel]() if channel is closed.
   /// \notes `operator<<` sets the channel in a bad state if it is closed.
   /// \notes `operator<<` returns a send-only channel that refers to the same channel.
-  auto send(const T& value) -> void
+  auto send(const T& value) -> void { check_send(state_->push(value, detail::wait_forever{})); }
+
+  /// \group send
+  auto send(T&& value) -> void { check_send(state_->push(std::move(value), detail::wait_forever{})); }
+
+  /// Constructs a value in place in the channel buffer.
+  ///
+  /// The value is built from `args` directly in the slot it will be received from,
+  /// so it is neither copied nor moved, except in the cases below.
+  ///
+  /// \notes Caller is blocked if the buffer is full.
+  /// \notes Throws [cool::closed_channel]() if channel is closed.
+  /// \notes With [cool::mpmc_backend](), a value whose construction may throw is built
+  ///        first and then moved into the buffer.
+  /// \notes With [cool::mutex_backend](), buffered values are moved when the buffer grows,
+  ///        which unbounded and resized buffers do.
+  /// \notes With [cool::priority_backend]() and [cool::bucket_backend](), values are moved
+  ///        into place.
+  template <typename... Args> auto emplace_send(Args&&... args) -> void
   {
-    {
-      auto l = lock();
-      state_->cv.wait(l, [this] { return non_blocking_is_closed() || non_blocking_has_space(); });
+    check_send(state_->emplace(detail::wait_forever{}, std::forward<Args>(args)...));
+  }
+
+  /// \group try_send Send data into the channel without blocking
+  ///
+  /// Sends data into the channel if there is room for it right away.
+  ///
+  /// \returns `true` if the value was sent, `false` if the buffer is full.
+  /// \notes The value is left untouched if it is not sent.
+  /// \notes Throws [cool::closed_channel]() if channel is closed.
+  NODISCARD auto try_send(const T& value) -> bool
+  {
+    return check_send(state_->push(value, detail::no_wait{})) == std::cv_status::no_timeout;
+  }
 
-      if (non_blocking_is_closed())
-        throw closed_channel{"channel is closed"};
+  /// \group try_send
+  NODISCARD auto try_send(T&& value) -> bool
+  {
+    return check_send(state_->push(std::move(value), detail::no_wait{})) == std::cv_status::no_timeout;
+  }
 
-      state_->buffer.push(value);
-    }
-    state_->cv.notify_one();
+  /// \group send_timed Send data into the channel with a timeout
+  ///
+  /// Sends data into the channel, blocking while the buffer is full for at most
+  /// `rel_time` or until `time` is reached.
+  ///
+  /// \notes The value is left untouched if it is not sent.
+  /// \notes Throws [cool::closed_channel]() if channel is closed.
+  template <typename Rep, typename Period>
+  auto send_for(const T& value, const std::chrono::duration<Rep, Period>& rel_time) -> std::cv_status
+  {
+    return send_until(value, std::chrono::steady_clock::now() + rel_time);
   }
 
-  /// \group send
-  auto send(T&& value) -> void
+  /// \group send_timed
+  template <typename Rep, typename Period>
+  auto send_for(T&& value, const std::chrono::duration<Rep, Period>& rel_time) -> std::cv_status
   {
-    {
-      auto l = lock();
-      state_->cv.wait(l, [this] { return non_blocking_is_closed() || non_blocking_has_space(); });
+    return send_until(std::move(value), std::chrono::steady_clock::now() + rel_time);
+  }
 
-      if (non_blocking_is_closed())
-        throw closed_channel{"channel is closed"};
+  /// \group send_timed
+  template <typename Clock, typename Duration>
+  auto send_until(const T& value, const std::chrono::time_point<Clock, Duration>& time) -> std::cv_status
+  {
+    return check_send(state_->push(value, detail::wait_until_time<Clock, Duration>{time}));
+  }
 
-      state_->buffer.push(std::move(value));
-    }
-    state_->cv.notify_one();
+  /// \group send_timed
+  template <typename Clock, typename Duration>
+  auto send_until(T&& value, const std::chrono::time_point<Clock, Duration>& time) -> std::cv_status
+  {
+    return check_send(state_->push(std::move(value), detail::wait_until_time<Clock, Duration>{time}));
+  }
+
+  /// \group send_status Send data into the channel reporting a status
+  ///
+  /// Same as `send`, `try_send`, `send_for` and `send_until`, but a closed channel is
+  /// reported as [cool::channel_status]() `closed` instead of an exception.
+  ///
+  /// \returns `ok` if the value was sent, `timeout` if it was not sent in time
+  ///          or the buffer is full when not blocking, and `closed` if the channel is closed.
+  /// \notes The value is left untouched if it is not sent.
+  auto send(const T& value, std::nothrow_t) -> channel_status { return state_->push(value, detail::wait_forever{}); }
+
+  /// \group send_status
+  auto send(T&& value, std::nothrow_t) -> channel_status { return state_->push(std::move(value), detail::wait_forever{}); }
+
+  /// \group send_status
+  NODISCARD auto try_send(const T& value, std::nothrow_t) -> channel_status { return state_->push(value, detail::no_wait{}); }
+
+  /// \group send_status
+  NODISCARD auto try_send(T&& value, std::nothrow_t) -> channel_status
+  {
+    return state_->push(std::move(value), detail::no_wait{});
+  }
+
+  /// \group send_status
+  template <typename Rep, typename Period>
+  auto send_for(const T& value, const std::chrono::duration<Rep, Period>& rel_time, std::nothrow_t) -> channel_status
+  {
+    return send_until(value, std::chrono::steady_clock::now() + rel_time, std::nothrow);
+  }
+
+  /// \group send_status
+  template <typename Rep, typename Period>
+  auto send_for(T&& value, const std::chrono::duration<Rep, Period>& rel_time, std::nothrow_t) -> channel_status
+  {
+    return send_until(std::move(value), std::chrono::steady_clock::now() + rel_time, std::nothrow);
+  }
+
+  /// \group send_status
+  template <typename Clock, typename Duration>
+  auto send_until(const T& value, const std::chrono::time_point<Clock, Duration>& time, std::nothrow_t) -> channel_status
+  {
+    return state_->push(value, detail::wait_until_time<Clock, Duration>{time});
+  }
+
+  /// \group send_status
+  template <typename Clock, typename Duration>
+  auto send_until(T&& value, const std::chrono::time_point<Clock, Duration>& time, std::nothrow_t) -> channel_status
+  {
+    return state_->push(std::move(value), detail::wait_until_time<Clock, Duration>{time});
+  }
+
+  /// \group send_batch Send several elements into the channel
+  ///
+  /// Sends the elements of `[first, last)`, or the `n` elements starting at `first`,
+  /// into the channel.
+  ///
+  /// As many elements as fit in the buffer are moved under a single synchronization
+  /// and a single notification; the caller then blocks until there is room for the rest.
+  ///
+  /// \notes Elements are copied; use [std::make_move_iterator]() to move them instead.
+  /// \notes Throws [cool::closed_channel]() if the channel is closed before all
+  ///        elements are sent.  Elements sent up to that point remain in the channel.
+  template <typename ForwardIt> auto send_range(ForwardIt first, ForwardIt last) -> void
+  {
+    send_n(first, static_cast<std::size_t>(std::distance(first, last)));
+  }
+
+  /// \group send_batch
+  template <typename ForwardIt> auto send_n(ForwardIt first, std::size_t n) -> void
+  {
+    if (state_->push_n(first, n) < n)
+      COOL_THROW(closed_channel{"channel is closed"});
   }
 
   /// \group receive Receive data from the channel
@@ -155,19 +1830,33 @@ public:
   /// \notes `operator>>` returns a receive-only channel that refers to the same channel.
   auto receive() -> T
   {
-    auto value = [this] {
-      auto l = lock();
-      state_->cv.wait(l, [this] { return non_blocking_is_closed() || non_blocking_has_value(); });
-
-      if (non_blocking_is_closed() && !non_blocking_has_value())
-        throw empty_closed_channel{"closed channel has no value"};
+    received<T> value;
+    state_->pop([&value](T&& v) { value.emplace(std::move(v)); }, detail::wait_forever{});
+    if (!value)
+      COOL_THROW(empty_closed_channel{"closed channel has no value"});
+    return *std::move(value);
+  }
 
-      auto value = std::move(state_->buffer.front());
-      state_->buffer.pop();
-      return value;
-    }();
+  /// Receives a value by reference.
+  ///
+  /// Calls `f` with an lvalue reference to the value while it is still in the channel
+  /// buffer, and destroys it in place afterwards; the value is never relocated.
+  ///
+  /// \notes Caller is blocked if no data is available.
+  /// \notes Throws [cool::empty_closed_channel]() if a closed channel is empty.
+  /// \notes With mutex-based backends, `f` runs while the channel is locked.
+  template <typename F> auto receive_with(F f) -> void
+  {
+    check_receive(state_->pop([&f](T&& value) { f(value); }, detail::wait_forever{}));
+  }
 
-    state_->cv.notify_one();
+  /// \group receive
+  ///
+  /// \notes `try_receive` never blocks: it returns an empty [cool::received]() if no data is available.
+  NODISCARD auto try_receive() -> received<T>
+  {
+    received<T> value;
+    check_receive(state_->pop([&value](T&& v) { value.emplace(std::move(v)); }, detail::no_wait{}));
     return value;
   }
 
@@ -184,96 +1873,132 @@ public:
   auto wait_until(const std::chrono::time_point<Rep, Period>& time, F f) ->
     typename std::enable_if<std::is_same<void, RESULT_OF_T(F, T)>::value, std::cv_status>::type
   {
-    {
-      auto l = lock();
-      state_->cv.wait_until(l, time, [this] { return non_blocking_is_closed() || non_blocking_has_value(); });
+    return check_receive(
+      state_->pop([&f](T&& value) { f(std::move(value)); }, detail::wait_until_time<Rep, Period>{time}));
+  }
 
-      if (non_blocking_is_closed() && !non_blocking_has_value())
-        throw empty_closed_channel{"closed channel has no value"};
+  /// \group receive_status Receive data from the channel reporting a status
+  ///
+  /// Receives data into `value`, reporting a closed and empty channel as
+  /// [cool::channel_status]() `closed` instead of an exception.
+  ///
+  /// (1) blocks until data is available.
+  ///
+  /// (2) never blocks.
+  ///
+  /// (3) and (4) block for at most `rel_time` or until `time` is reached.
+  ///
+  /// \returns `ok` if a value was received, `timeout` if none was available in time,
+  ///          and `closed` if the channel is closed and empty.
+  /// \notes `value` is move-assigned, and left untouched if nothing is received.
+  auto receive(T& value) -> channel_status
+  {
+    return state_->pop([&value](T&& v) { value = std::move(v); }, detail::wait_forever{});
+  }
 
-      if (!non_blocking_has_value())
-        return std::cv_status::timeout;
+  /// \group receive_status
+  NODISCARD auto try_receive(T& value) -> channel_status
+  {
+    return state_->pop([&value](T&& v) { value = std::move(v); }, detail::no_wait{});
+  }
 
-      f(std::move(state_->buffer.front()));
-      state_->buffer.pop();
-    }
+  /// \group receive_status
+  template <typename Rep, typename Period>
+  auto receive_for(T& value, const std::chrono::duration<Rep, Period>& rel_time) -> channel_status
+  {
+    return receive_until(value, std::chrono::steady_clock::now() + rel_time);
+  }
 
-    state_->cv.notify_one();
-    return std::cv_status::no_timeout;
+  /// \group receive_status
+  template <typename Clock, typename Duration>
+  auto receive_until(T& value, const std::chrono::time_point<Clock, Duration>& time) -> channel_status
+  {
+    return state_->pop([&value](T&& v) { value = std::move(v); }, detail::wait_until_time<Clock, Duration>{time});
   }
 
-  /// Closes a channel.
-  /// \notes If the channel is already closed, nothing happens.
-  auto close() noexcept -> void
+  /// \group receive_batch Receive several elements from the channel
+  ///
+  /// Receives the elements available in the channel.
+  ///
+  /// (1) moves at most `max_n` elements into `out` and returns the iterator past the last one.
+  ///
+  /// (2) appends every available element to `out` and returns how many were received.
+  ///
+  /// All available elements are moved under a single synchronization and a single notification.
+  ///
+  /// \notes Caller is blocked if no data is available.
+  /// \notes Throws [cool::empty_closed_channel]() if a closed channel is empty.
+  template <typename OutputIt> auto receive_into(OutputIt out, std::size_t max_n) -> OutputIt
   {
-    auto l = lock();
-    state_->closed = true;
-    state_->cv.notify_all();
+    if (max_n > 0 && state_->pop_n([&out](T&& value) { *out++ = std::move(value); }, max_n) == 0)
+      COOL_THROW(empty_closed_channel{"closed channel has no value"});
+
+    return out;
   }
 
-  /// Queries whether a channel is closed or not.
-  NODISCARD auto is_closed() const noexcept -> bool
+  /// \group receive_batch
+  auto drain(std::vector<T>& out) -> std::size_t
   {
-    auto l = lock();
-    return non_blocking_is_closed();
+    const auto size = out.size();
+    receive_into(std::back_inserter(out), std::numeric_limits<std::size_t>::max());
+    return out.size() - size;
   }
 
+  /// \group iteration Iterate over received data
+  ///
+  /// Returns input iterators that receive data until the channel is closed and empty,
+  /// so that `for (auto&& value : ch)` drains the channel.
+  ///
+  /// \notes `begin` blocks until the first value is received or the channel is closed.
+  /// \notes Iterators refer to the channel without sharing its ownership.
+  auto begin() -> iterator { return iterator{state_.get()}; }
+
+  /// \group iteration
+  auto end() noexcept -> iterator { return iterator{}; }
+
+  /// Closes a channel.
+  /// \notes If the channel is already closed, nothing happens.
+  auto close() noexcept -> void { state_->close(); }
+
+  /// Queries whether a channel is closed or not.
+  NODISCARD auto is_closed() const noexcept -> bool { return state_->is_closed(); }
+
+  /// Returns a snapshot of the channel statistics.
+  ///
+  /// \notes Only available for [cool::instrumented]() backends.
+  NODISCARD auto stats() const noexcept -> channel_stats { return state_->stats(); }
+
   /// Sets the size of the internal buffer.
   ///
   /// \notes If the channel has more elements buffered, the elements are kept until received.
   /// \notes If the buffer had been full and this function is called with `size`
   ///        greater than the previous size, blocked calls of
   ///        `send` are signaled.
-  auto buffer_size(std::size_t size) noexcept -> void
-  {
-    auto l = lock();
-    state_->buffer_size = size;
-    state_->cv.notify_all();
-  }
+  /// \notes Only available for mutex-based backends: [cool::mutex_backend](),
+  ///        [cool::priority_backend](), and [cool::bucket_backend]().
+  auto buffer_size(std::size_t size) noexcept -> void { state_->buffer_size(size); }
 
   /// Returns the size of the internal buffer.
-  NODISCARD auto buffer_size() const noexcept -> std::size_t
-  {
-    auto l = lock();
-    return state_->buffer_size;
-  }
+  NODISCARD auto buffer_size() const noexcept -> std::size_t { return state_->buffer_size(); }
 
   /// \group send
-  auto operator<<(const T& value) -> ochannel<T>
+  auto operator<<(const T& value) -> ochannel<T, Backend>
   {
-    try {
-      send(value);
-      bad_ = false;
-    } catch (const closed_channel&) {
-      bad_ = true;
-    }
-
+    bad_ = send(value, std::nothrow) != channel_status::ok;
     return *this;
   }
 
   /// \group send
-  auto operator<<(T&& value) -> ochannel<T>
+  auto operator<<(T&& value) -> ochannel<T, Backend>
   {
-    try {
-      send(std::move(value));
-      bad_ = false;
-    } catch (const closed_channel&) {
-      bad_ = true;
-    }
-
+    bad_ = send(std::move(value), std::nothrow) != channel_status::ok;
     return *this;
   }
 
   /// \group receive
-  auto operator>>(T& value) noexcept -> ichannel<T>
+  auto operator>>(T& value) noexcept -> ichannel<T, Backend>
   {
-    try {
-      value = receive();
-      bad_ = false;
-    } catch (const empty_closed_channel&) {
-      bad_ = true;
-    }
-
+    bad_ = receive(value) != channel_status::ok;
     return *this;
   }
 
@@ -284,32 +2009,39 @@ public:
   explicit operator bool() const noexcept { return !bad_; }
 
   /// \group comparison Checks whether or not two channels are the same.
-  auto operator==(const channel<T>& other) const noexcept -> bool { return state_ == other.state_; }
+  auto operator==(const channel& other) const noexcept -> bool { return state_ == other.state_; }
 
   /// \group comparison
-  auto operator==(const ichannel<T>& other) const noexcept -> bool { return state_ == other.state_; }
+  auto operator==(const ichannel<T, Backend>& other) const noexcept -> bool { return state_ == other.state_; }
 
   /// \group comparison
-  auto operator==(const ochannel<T>& other) const noexcept -> bool { return state_ == other.state_; }
+  auto operator==(const ochannel<T, Backend>& other) const noexcept -> bool { return state_ == other.state_; }
 
   /// \group comparison
-  auto operator!=(const channel<T>& other) const noexcept -> bool { return state_ != other.state_; }
+  auto operator!=(const channel& other) const noexcept -> bool { return state_ != other.state_; }
 
   /// \group comparison
-  auto operator!=(const ichannel<T>& other) const noexcept -> bool { return state_ != other.state_; }
+  auto operator!=(const ichannel<T, Backend>& other) const noexcept -> bool { return state_ != other.state_; }
 
   /// \group comparison
-  auto operator!=(const ochannel<T>& other) const noexcept -> bool { return state_ != other.state_; }
+  auto operator!=(const ochannel<T, Backend>& other) const noexcept -> bool { return state_ != other.state_; }
 
 private:
-  NODISCARD auto non_blocking_has_space() const noexcept -> bool { return state_->buffer.size() < state_->buffer_size; }
-  NODISCARD auto non_blocking_has_value() const noexcept -> bool { return state_->buffer.size() > 0; }
-
-  NODISCARD auto non_blocking_is_closed() const noexcept -> bool { return state_->closed; }
+  static auto check_send(channel_status result) -> std::cv_status
+  {
+    if (result == channel_status::closed)
+      COOL_THROW(closed_channel{"channel is closed"});
+    return result == channel_status::ok ? std::cv_status::no_timeout : std::cv_status::timeout;
+  }
 
-  NODISCARD auto lock() const noexcept -> std::unique_lock<std::mutex> { return std::unique_lock<std::mutex>{state_->mutex}; }
+  static auto check_receive(channel_status result) -> std::cv_status
+  {
+    if (result == channel_status::closed)
+      COOL_THROW(empty_closed_channel{"closed channel has no value"});
+    return result == channel_status::ok ? std::cv_status::no_timeout : std::cv_status::timeout;
+  }
 
-  std::shared_ptr<detail::channel_state<T>> state_;
+  std::shared_ptr<detail::channel_state<T, Backend>> state_;
   bool bad_ = false;
 };
 
@@ -321,13 +2053,14 @@ private:
 /// \module Channel
 ///
 /// \notes After constructed, following copies refer to the same channel.
-template <typename T> class ichannel : private channel<T>
+template <typename T, typename Backend> class ichannel : private channel<T, Backend>
 {
-  friend class channel<T>;
+  friend class channel<T, Backend>;
+  friend class select;
 
 public:
   /// \exclude
-  ichannel(const channel<T>& ch) noexcept : channel<T>{ch} {}
+  ichannel(const channel<T, Backend>& ch) noexcept : channel<T, Backend>{ch} {}
 
   /// \exclude
   ichannel(const ichannel& source) noexcept = default;
@@ -341,14 +2074,27 @@ public:
   /// \exclude
   auto operator=(ichannel&& source) noexcept -> ichannel& = default;
 
-  using channel<T>::is_closed;
-  using channel<T>::buffer_size;
-  using channel<T>::operator bool;
-  using channel<T>::operator==;
-  using channel<T>::operator!=;
-
-  using channel<T>::receive;
-  using channel<T>::operator>>;
+  using channel<T, Backend>::is_closed;
+  using channel<T, Backend>::buffer_size;
+  using channel<T, Backend>::stats;
+  using channel<T, Backend>::operator bool;
+  using channel<T, Backend>::operator==;
+  using channel<T, Backend>::operator!=;
+
+  using channel<T, Backend>::receive;
+  using channel<T, Backend>::receive_with;
+  using channel<T, Backend>::try_receive;
+  using channel<T, Backend>::receive_for;
+  using channel<T, Backend>::receive_until;
+  using channel<T, Backend>::receive_into;
+  using channel<T, Backend>::drain;
+  using channel<T, Backend>::wait_for;
+  using channel<T, Backend>::wait_until;
+  using channel<T, Backend>::operator>>;
+
+  using typename channel<T, Backend>::iterator;
+  using channel<T, Backend>::begin;
+  using channel<T, Backend>::end;
 };
 
 /// Output channel that can be constructed from a channel.
@@ -359,13 +2105,14 @@ public:
 /// \module Channel
 ///
 /// \notes After constructed, following copies refer to the same channel.
-template <typename T> class ochannel : private channel<T>
+template <typename T, typename Backend> class ochannel : private channel<T, Backend>
 {
-  friend class channel<T>;
+  friend class channel<T, Backend>;
+  friend class select;
 
 public:
   /// \exclude
-  ochannel(const channel<T>& ch) noexcept : channel<T>{ch} {}
+  ochannel(const channel<T, Backend>& ch) noexcept : channel<T, Backend>{ch} {}
 
   /// \exclude
   ochannel(const ochannel& source) noexcept = default;
@@ -379,20 +2126,27 @@ public:
   /// \exclude
   auto operator=(ochannel&& source) noexcept -> ochannel& = default;
 
-  using channel<T>::close;
-  using channel<T>::is_closed;
-  using channel<T>::buffer_size;
-  using channel<T>::operator bool;
-  using channel<T>::operator==;
-  using channel<T>::operator!=;
-
-  using channel<T>::send;
-  using channel<T>::operator<<;
+  using channel<T, Backend>::close;
+  using channel<T, Backend>::is_closed;
+  using channel<T, Backend>::buffer_size;
+  using channel<T, Backend>::stats;
+  using channel<T, Backend>::operator bool;
+  using channel<T, Backend>::operator==;
+  using channel<T, Backend>::operator!=;
+
+  using channel<T, Backend>::send;
+  using channel<T, Backend>::emplace_send;
+  using channel<T, Backend>::try_send;
+  using channel<T, Backend>::send_for;
+  using channel<T, Backend>::send_until;
+  using channel<T, Backend>::send_range;
+  using channel<T, Backend>::send_n;
+  using channel<T, Backend>::operator<<;
 };
 
 /// \exclude
 struct eod_t {
-  template <typename T> friend auto operator<<(ochannel<T> ch, eod_t) -> ochannel<T>
+  template <typename T, typename Backend> friend auto operator<<(ochannel<T, Backend> ch, eod_t) -> ochannel<T, Backend>
   {
     ch.close();
     return ch;
@@ -404,9 +2158,253 @@ struct eod_t {
 /// One can send `eod` through a channel to close it.
 constexpr eod_t eod;
 
+/// Waits on several channel operations at once.
+///
+/// Cases are registered with `receive`, `send`, `otherwise` (the default case),
+/// and `after` (the timeout case).  `wait` performs exactly one of them: the first
+/// channel operation that can proceed, or else the default case if any, or else
+/// the timeout case once it expires.
+///
+/// The waiting thread is registered with every channel involved and woken
+/// directly by whichever becomes ready first; it never busy-waits.
+///
+/// \module Channel
+///
+/// \notes When several operations are ready, the cases are tried in a rotating order
+///        so that no channel is starved.
+/// \notes Receiving from a closed and empty channel never becomes ready.  If every
+///        channel case is such a receive, `wait` throws [cool::empty_closed_channel]().
+/// \notes If a send case refers to a closed channel, `wait` throws [cool::closed_channel]().
+/// \notes The same object can be waited on repeatedly.
+class select
+{
+public:
+  /// Adds a case that receives a value from `ch` and passes it to `f`.
+  template <typename T, typename Backend, typename F> auto receive(const ichannel<T, Backend>& ch, F f) -> select&
+  {
+    return receive(static_cast<const channel<T, Backend>&>(ch), std::move(f));
+  }
+
+  /// \exclude
+  template <typename T, typename Backend, typename F> auto receive(const channel<T, Backend>& ch, F f) -> select&
+  {
+    cases_.emplace_back(std::unique_ptr<case_base>{new receive_case<T, Backend, F>{ch.state_, std::move(f)}}, index_++);
+    return *this;
+  }
+
+  /// Adds a case that sends a copy of `value` into `ch` and then calls `f()`.
+  template <typename T, typename Backend, typename F>
+  auto send(const ochannel<T, Backend>& ch, typename detail::identity<T>::type value, F f) -> select&
+  {
+    return send(static_cast<const channel<T, Backend>&>(ch), std::move(value), std::move(f));
+  }
+
+  /// \exclude
+  template <typename T, typename Backend, typename F>
+  auto send(const channel<T, Backend>& ch, typename detail::identity<T>::type value, F f) -> select&
+  {
+    cases_.emplace_back(std::unique_ptr<case_base>{new send_case<T, Backend, F>{ch.state_, std::move(value), std::move(f)}},
+                        index_++);
+    return *this;
+  }
+
+  /// Sets the default case, which runs when no operation can proceed immediately.
+  template <typename F> auto otherwise(F f) -> select&
+  {
+    otherwise_ = std::move(f);
+    otherwise_index_ = index_++;
+    return *this;
+  }
+
+  /// Sets the timeout case, which runs when no operation could proceed within `rel_time`.
+  template <typename Rep, typename Period, typename F>
+  auto after(const std::chrono::duration<Rep, Period>& rel_time, F f) -> select&
+  {
+    timeout_ = std::chrono::duration_cast<std::chrono::steady_clock::duration>(rel_time);
+    after_ = std::move(f);
+    after_index_ = index_++;
+    return *this;
+  }
+
+  /// Performs one of the cases, blocking if needed.
+  ///
+  /// \returns The index of the case performed, in the order they were added.
+  auto wait() -> std::size_t
+  {
+    const auto deadline = std::chrono::steady_clock::now() + timeout_;
+
+    auto ready = poll();
+    if (ready != none)
+      return fire(ready);
+
+    if (otherwise_) {
+      otherwise_();
+      return otherwise_index_;
+    }
+
+    detail::selector waiter;
+    watching guard{cases_, waiter};
+
+    while (true) {
+      ready = poll();
+      if (ready != none) {
+        guard.release();
+        return fire(ready);
+      }
+
+      if (!after_) {
+        waiter.wait();
+      } else if (!waiter.wait_until(deadline)) {
+        guard.release();
+        after_();
+        return after_index_;
+      }
+    }
+  }
+
+private:
+  static constexpr std::size_t none = std::numeric_limits<std::size_t>::max();
+
+  struct case_base {
+    case_base() = default;
+    case_base(const case_base&) = delete;
+    auto operator=(const case_base&) -> case_base& = delete;
+    virtual ~case_base() = default;
+
+    // Tries the operation without blocking; on success, `fire` runs the handler.
+    virtual auto poll() -> channel_status = 0;
+    virtual auto fire() -> void = 0;
+
+    virtual auto watch(detail::selector* s) -> void = 0;
+    virtual auto unwatch(detail::selector* s) noexcept -> void = 0;
+  };
+
+  template <typename T, typename Backend, typename F> struct receive_case : case_base {
+    receive_case(std::shared_ptr<detail::channel_state<T, Backend>> state, F f) : state{std::move(state)}, f(std::move(f)) {}
+
+    auto poll() -> channel_status override
+    {
+      return state->pop([this](T&& v) { value.emplace(std::move(v)); }, detail::no_wait{});
+    }
+
+    auto fire() -> void override
+    {
+      auto v = *std::move(value);
+      value.reset();
+      f(std::move(v));
+    }
+
+    auto watch(detail::selector* s) -> void override { state->watch(s, false); }
+    auto unwatch(detail::selector* s) noexcept -> void override { state->unwatch(s, false); }
+
+    std::shared_ptr<detail::channel_state<T, Backend>> state;
+    F f;
+    received<T> value;
+  };
+
+  template <typename T, typename Backend, typename F> struct send_case : case_base {
+    send_case(std::shared_ptr<detail::channel_state<T, Backend>> state, T value, F f)
+      : state{std::move(state)}, value(std::move(value)), f(std::move(f))
+    {
+    }
+
+    auto poll() -> channel_status override
+    {
+      const auto result = state->push(static_cast<const T&>(value), detail::no_wait{});
+      if (result == channel_status::closed)
+        COOL_THROW(closed_channel{"channel is closed"});
+      return result;
+    }
+
+    auto fire() -> void override { f(); }
+
+    auto watch(detail::selector* s) -> void override { state->watch(s, true); }
+    auto unwatch(detail::selector* s) noexcept -> void override { state->unwatch(s, true); }
+
+    std::shared_ptr<detail::channel_state<T, Backend>> state;
+    T value;
+    F f;
+  };
+
+  struct entry {
+    entry(std::unique_ptr<case_base> c, std::size_t index) : c{std::move(c)}, index{index} {}
+
+    std::unique_ptr<case_base> c;
+    std::size_t index;
+  };
+
+  // Keeps the waiting thread registered with every channel while in scope.
+  class watching
+  {
+  public:
+    watching(std::vector<entry>& cases, detail::selector& waiter) : cases_{cases}, waiter_{waiter}
+    {
+      for (; watched_ < cases_.size(); ++watched_)
+        cases_[watched_].c->watch(&waiter_);
+    }
+
+    watching(const watching&) = delete;
+    auto operator=(const watching&) -> watching& = delete;
+
+    ~watching() { release(); }
+
+    auto release() noexcept -> void
+    {
+      for (; watched_ > 0; --watched_)
+        cases_[watched_ - 1].c->unwatch(&waiter_);
+    }
+
+  private:
+    std::vector<entry>& cases_;
+    detail::selector& waiter_;
+    std::size_t watched_ = 0;
+  };
+
+  // Returns the position of a case that completed, or `none`.
+  auto poll() -> std::size_t
+  {
+    auto closed = std::size_t{0};
+    for (auto i = std::size_t{0}; i < cases_.size(); ++i) {
+      const auto k = (next_ + i) % cases_.size();
+      switch (cases_[k].c->poll()) {
+      case channel_status::ok:
+        next_ = k + 1;
+        return k;
+      case channel_status::closed:
+        ++closed;
+        break;
+      default:
+        break;
+      }
+    }
+
+    if (closed == cases_.size() && !otherwise_ && !after_)
+      COOL_THROW(empty_closed_channel{"closed channel has no value"});
+
+    return none;
+  }
+
+  auto fire(std::size_t k) -> std::size_t
+  {
+    cases_[k].c->fire();
+    return cases_[k].index;
+  }
+
+  std::vector<entry> cases_;
+  std::size_t next_ = 0;
+  std::size_t index_ = 0;
+
+  std::function<void()> otherwise_;
+  std::size_t otherwise_index_ = none;
+
+  std::chrono::steady_clock::duration timeout_{};
+  std::function<void()> after_;
+  std::size_t after_index_ = none;
+};
+
 } // namespace cool
 
 #undef RESULT_OF_T
-#undef NODISCARD
+#include <cool/undef_channel_macros.hpp>
 
 #endif // COOL_CHANNEL_HXX_INCLUDED
@@ -0,0 +1,22 @@
+// Macros shared by the channel headers, undefined by undef_channel_macros.hpp.
+//
+// No include guard: each header includes this file first and
+// undef_channel_macros.hpp last.
+
+#if __cplusplus >= 201603L
+#define NODISCARD [[nodiscard]]
+#else
+#define NODISCARD
+#endif
+
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND)
+#define COOL_TRY try
+#define COOL_CATCH_ALL catch (...)
+#define COOL_RETHROW throw
+#define COOL_THROW(e) throw e
+#else
+#define COOL_TRY if (true)
+#define COOL_CATCH_ALL else
+#define COOL_RETHROW std::abort()
+#define COOL_THROW(e) std::abort()
+#endif
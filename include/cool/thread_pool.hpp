@@ -2,13 +2,28 @@
 #define COOL_THREAD_POOL_HPP_INCLUDED
 
 #include <cool/indices.hpp>
+#include <cool/wait_strategy.hpp>
+#include <cool/worker_placement.hpp>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
 #include <functional>
 #include <future>
+#include <memory>
 #include <mutex>
+#include <ostream>
 #include <queue>
+#include <stdexcept>
+#include <string>
 #include <thread>
 #include <type_traits>
+#include <vector>
 
 #if __cplusplus >= 201703L
 /// \exclude
@@ -26,105 +41,2280 @@ class closed_thread_pool : public std::system_error
   using std::system_error::system_error;
 };
 
+class full_thread_pool : public std::system_error
+{
+  using std::system_error::system_error;
+};
+
+/// How a thread pool hands tasks to its workers.
+///
+/// `shared_queue` keeps every task in a single queue guarded by a mutex.
+///
+/// `work_stealing` gives each worker a deque of its own: tasks enqueued from a worker
+/// go to its deque, where it takes the most recent first, and idle workers steal the
+/// oldest tasks of random victims.  Tasks enqueued from other threads go through the
+/// shared queue.
+enum class scheduling { shared_queue, work_stealing };
+
+/// Priority of a task in a thread pool.
+///
+/// Workers run `high` tasks first and `low` tasks last, in FIFO order within a priority.
+/// To prevent starvation, tasks of a lower priority are run anyway once higher-priority
+/// tasks were picked over them 32 times.
+///
+/// \notes With work stealing, `high` and `low` tasks always go through the shared queue,
+///        which workers check first when it holds `high` tasks.
+enum class task_priority { high, normal, low };
+
+/// What happens to the queued tasks of a thread pool when it shuts down.
+///
+/// - `drain` runs all of them.
+/// - `cancel_pending` drops the tasks that didn't start, and cancels the token of the pool
+///   so that running tasks can stop early.  The futures of dropped tasks hold a
+///   `std::future_error` with the `broken_promise` error code.
+enum class shutdown_policy { drain, cancel_pending };
+
+/// Cooperative cancellation flag, observed by tasks through its tokens.
+///
+/// \module Thread pool
+class cancellation_source;
+
+/// Read-only view of a `cancellation_source`, to be passed to tasks that may stop early.
+///
+/// A default-constructed token is never cancelled.
+///
+/// \module Thread pool
+class cancellation_token
+{
+public:
+  cancellation_token() noexcept = default;
+
+  /// Checks whether the source was cancelled.
+  auto is_cancelled() const noexcept -> bool { return flag_ != nullptr && flag_->load(std::memory_order_acquire); }
+
+private:
+  friend class cancellation_source;
+
+  explicit cancellation_token(std::shared_ptr<const std::atomic<bool>> flag) noexcept : flag_{std::move(flag)} {}
+
+  std::shared_ptr<const std::atomic<bool>> flag_;
+};
+
+class cancellation_source
+{
+public:
+  cancellation_source() : flag_{std::make_shared<std::atomic<bool>>(false)} {}
+
+  /// Returns a token observing this source.
+  auto token() const -> cancellation_token { return cancellation_token{flag_}; }
+
+  /// Cancels the source and all its tokens.
+  auto cancel() noexcept -> void { flag_->store(true, std::memory_order_release); }
+
+  /// Checks whether the source was cancelled.
+  auto is_cancelled() const noexcept -> bool { return flag_->load(std::memory_order_acquire); }
+
+private:
+  std::shared_ptr<std::atomic<bool>> flag_;
+};
+
+/// What happens to a task submitted while the shared queue of a thread pool is full.
+///
+/// - `block` waits for workers to make room.
+/// - `reject` throws `full_thread_pool`.
+/// - `caller_runs` runs the task on the submitting thread, before returning.
+///
+/// \notes Workers never wait for room, as that could deadlock the pool: with `block`, tasks
+///        they submit to a full queue run right away, as with `caller_runs`.
+enum class overflow_policy { block, reject, caller_runs };
+
+/// Bounds of an elastic thread pool.
+///
+/// An elastic pool starts `min_threads` workers.  It starts another one, up to
+/// `max_threads`, whenever more tasks are queued than workers are idle, which happens
+/// when tasks come in faster than they run or when workers are blocked.  A worker idle
+/// for `idle_timeout` retires, unless the pool would drop below `min_threads`.
+struct elastic_limits {
+  elastic_limits(std::size_t min_threads, std::size_t max_threads,
+                 std::chrono::milliseconds idle_timeout = std::chrono::seconds{10}) noexcept
+    : min_threads{min_threads}, max_threads{max_threads}, idle_timeout{idle_timeout}
+  {
+  }
+
+  std::size_t min_threads;
+  std::size_t max_threads;
+  std::chrono::milliseconds idle_timeout;
+};
+
+/// Histogram of durations, whose buckets are powers of two nanoseconds.
+///
+/// `counts[i]` counts the durations in `[2^i, 2^(i+1))` nanoseconds; the first bucket also
+/// counts zero durations and the last one all longer durations.
+///
+/// \module Thread pool
+struct duration_histogram {
+  static constexpr std::size_t buckets = 40;
+
+  /// Returns the number of recorded durations.
+  auto total() const noexcept -> std::uint64_t
+  {
+    auto sum = std::uint64_t{0};
+    for (const auto count : counts)
+      sum += count;
+    return sum;
+  }
+
+  /// Returns an upper bound of the `q`-quantile of the durations, for `q` in `[0, 1]`.
+  auto quantile(double q) const noexcept -> std::chrono::nanoseconds
+  {
+    const auto rank = std::max(std::uint64_t{1}, static_cast<std::uint64_t>(q * static_cast<double>(total()) + 0.5));
+    auto seen = std::uint64_t{0};
+    for (auto i = std::size_t{0}; i < buckets; ++i) {
+      seen += counts[i];
+      if (seen >= rank)
+        return std::chrono::nanoseconds{std::int64_t{1} << (i + 1)};
+    }
+    return std::chrono::nanoseconds{0};
+  }
+
+  std::array<std::uint64_t, buckets> counts;
+};
+
+/// Statistics of a thread pool, as returned by `thread_pool::stats`.
+///
+/// - `tasks` counts the tasks run since statistics were enabled.
+/// - `queued` is the number of tasks waiting to run, and `threads` the number of workers.
+/// - `queue_latency` records the time between enqueuing and starting tasks, and `run_time`
+///   their execution time.
+/// - `workers` holds, for each worker, the number of tasks it ran and stole, and the time it
+///   was busy running tasks or idle.
+/// - `retired` adds up the counters of the workers of an elastic pool that retired and
+///   were joined, which no longer appear in `workers`.
+///
+/// \module Thread pool
+///
+/// \notes Counters are read atomically, but not all at once: while the pool is in use, a
+///        snapshot may be slightly inconsistent.
+struct thread_pool_stats {
+  struct worker {
+    std::uint64_t tasks;
+    std::uint64_t steals;
+    std::chrono::nanoseconds busy;
+    std::chrono::nanoseconds idle;
+    bool running;
+  };
+
+  /// Returns the share of time workers spent running tasks, between 0 and 1.
+  auto utilization() const noexcept -> double
+  {
+    auto busy = retired.busy;
+    auto idle = retired.idle;
+    for (const auto& w : workers) {
+      busy += w.busy;
+      idle += w.idle;
+    }
+    const auto total = busy + idle;
+    return total.count() > 0 ? static_cast<double>(busy.count()) / static_cast<double>(total.count()) : 0.0;
+  }
+
+  std::uint64_t tasks;
+  std::uint64_t overflows;
+  std::size_t queued;
+  std::size_t threads;
+  duration_histogram queue_latency;
+  duration_histogram run_time;
+  std::vector<worker> workers;
+  worker retired;
+};
+
+/// A task run by a thread pool, as passed to trace hooks.
+///
+/// `worker` is the index of the worker that ran the task, or `static_cast<std::size_t>(-1)`
+/// for a thread that isn't a worker but helped the pool.
+///
+/// \module Thread pool
+struct task_event {
+  std::size_t worker;
+  std::chrono::steady_clock::time_point enqueued;
+  std::chrono::steady_clock::time_point started;
+  std::chrono::steady_clock::time_point finished;
+};
+
+/// Trace hook writing task events in the Chrome trace event format.
+///
+/// The output is a JSON array of complete events, one per task, that `chrome://tracing`
+/// and Perfetto can load.  The array is closed once the last copy of the hook is destroyed,
+/// typically when the pool drops it.
+///
+/// \module Thread pool
+///
+/// \notes `out` must outlive the hook.
+class chrome_trace
+{
+public:
+  explicit chrome_trace(std::ostream& out) : state_{std::make_shared<state>(out)} {}
+
+  auto operator()(const task_event& event) const -> void
+  {
+    const auto worker = event.worker == static_cast<std::size_t>(-1) ? -1 : static_cast<long long>(event.worker);
+    char line[256];
+    std::snprintf(line, sizeof(line),
+                  "{\"name\":\"task\",\"ph\":\"X\",\"pid\":1,\"tid\":%lld,"
+                  "\"ts\":%s,\"dur\":%s,\"args\":{\"queued_us\":%s}}",
+                  worker, micros(event.started - state_->origin).c_str(), micros(event.finished - event.started).c_str(),
+                  micros(event.started - event.enqueued).c_str());
+
+    auto l = std::unique_lock<std::mutex>(state_->mutex);
+    state_->out << (state_->first ? "[\n" : ",\n") << line;
+    state_->first = false;
+  }
+
+private:
+  struct state {
+    explicit state(std::ostream& out) : out(out), origin{std::chrono::steady_clock::now()} {}
+    ~state() { out << (first ? "[" : "") << "\n]\n"; }
+
+    std::ostream& out;
+    const std::chrono::steady_clock::time_point origin;
+    std::mutex mutex;
+    bool first = true;
+  };
+
+  static auto micros(std::chrono::steady_clock::duration d) -> std::string
+  {
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+    char text[32];
+    const auto magnitude = static_cast<long long>(ns < 0 ? -ns : ns);
+    std::snprintf(text, sizeof(text), "%s%lld.%03lld", ns < 0 ? "-" : "", magnitude / 1000, magnitude % 1000);
+    return text;
+  }
+
+  std::shared_ptr<state> state_;
+};
+
+/// \exclude
+namespace detail
+{
+
+// Chase-Lev work-stealing deque, after Lê et al., "Correct and efficient
+// work-stealing for weak memory models".  The owner pushes and takes at the
+// bottom, thieves steal at the top.  Arrays replaced when growing are kept
+// until the deque is destroyed, since a thief may still be reading them.
+template <typename T> class work_deque
+{
+public:
+  work_deque()
+  {
+    arrays_.emplace_back(new array{initial_capacity});
+    array_.store(arrays_.back().get(), std::memory_order_relaxed);
+  }
+
+  work_deque(const work_deque&) = delete;
+  auto operator=(const work_deque&) -> work_deque& = delete;
+
+  ~work_deque()
+  {
+    auto* a = array_.load(std::memory_order_relaxed);
+    for (auto i = top_.load(std::memory_order_relaxed); i < bottom_.load(std::memory_order_relaxed); ++i)
+      delete a->get(i);
+  }
+
+  // Owner only.
+  auto push(T* x) -> void
+  {
+    const auto b = bottom_.load(std::memory_order_relaxed);
+    const auto t = top_.load(std::memory_order_acquire);
+    auto* a = array_.load(std::memory_order_relaxed);
+    if (b - t > a->mask)
+      a = grow(a, t, b);
+
+    a->put(b, x);
+    bottom_.store(b + 1, std::memory_order_release);
+  }
+
+  // Owner only.  Returns `nullptr` if the deque is empty.
+  auto take() -> T*
+  {
+    const auto b = bottom_.load(std::memory_order_relaxed) - 1;
+    auto* a = array_.load(std::memory_order_relaxed);
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto t = top_.load(std::memory_order_relaxed);
+
+    if (t > b) {
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+
+    auto* x = a->get(b);
+    if (t == b) {
+      // Last element: race against thieves for it.
+      if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        x = nullptr;
+      bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+    return x;
+  }
+
+  // Any thread.  Returns `nullptr` if the deque is empty or another thread won the race.
+  auto steal() -> T*
+  {
+    auto t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const auto b = bottom_.load(std::memory_order_acquire);
+    if (t >= b)
+      return nullptr;
+
+    auto* x = array_.load(std::memory_order_acquire)->get(t);
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+      return nullptr;
+    return x;
+  }
+
+  auto empty() const noexcept -> bool
+  {
+    return top_.load(std::memory_order_acquire) >= bottom_.load(std::memory_order_acquire);
+  }
+
+  // Approximate while other threads use the deque.
+  auto size() const noexcept -> std::size_t
+  {
+    const auto t = top_.load(std::memory_order_acquire);
+    const auto b = bottom_.load(std::memory_order_acquire);
+    return b > t ? static_cast<std::size_t>(b - t) : 0;
+  }
+
+private:
+  static constexpr std::int64_t initial_capacity = 64;
+
+  struct array {
+    explicit array(std::int64_t capacity) : mask{capacity - 1}, slots{new std::atomic<T*>[static_cast<std::size_t>(capacity)]} {}
+
+    auto get(std::int64_t i) const noexcept -> T* { return slot(i).load(std::memory_order_relaxed); }
+    auto put(std::int64_t i, T* x) noexcept -> void { slot(i).store(x, std::memory_order_relaxed); }
+    auto slot(std::int64_t i) const noexcept -> std::atomic<T*>& { return slots[static_cast<std::size_t>(i & mask)]; }
+
+    const std::int64_t mask;
+    const std::unique_ptr<std::atomic<T*>[]> slots;
+  };
+
+  auto grow(array* a, std::int64_t t, std::int64_t b) -> array*
+  {
+    arrays_.emplace_back(new array{2 * (a->mask + 1)});
+    auto* bigger = arrays_.back().get();
+    for (auto i = t; i < b; ++i)
+      bigger->put(i, a->get(i));
+    array_.store(bigger, std::memory_order_release);
+    return bigger;
+  }
+
+  char pad0_[64];
+  std::atomic<std::int64_t> top_{0};
+
+  char pad1_[64];
+  std::atomic<std::int64_t> bottom_{0};
+  std::atomic<array*> array_{nullptr};
+  std::vector<std::unique_ptr<array>> arrays_;
+};
+
+// Move-only `void()` callable.  Callables that fit in the inline buffer and
+// can be moved without throwing are stored in place, others on the heap.
+class task
+{
+public:
+  task() noexcept = default;
+
+  template <typename F, typename D = typename std::decay<F>::type,
+            typename = typename std::enable_if<!std::is_same<D, task>::value>::type>
+  task(F&& f) : ops_{store<D>(std::forward<F>(f), std::integral_constant<bool, fits_inline<D>()>{})}
+  {
+  }
+
+  task(task&& other) noexcept : ops_{other.ops_}, enqueued_{other.enqueued_}
+  {
+    if (ops_ != nullptr)
+      ops_->move(other.storage_, storage_);
+    other.ops_ = nullptr;
+  }
+
+  auto operator=(task&& other) noexcept -> task&
+  {
+    if (this != &other) {
+      reset();
+      ops_ = other.ops_;
+      enqueued_ = other.enqueued_;
+      if (ops_ != nullptr)
+        ops_->move(other.storage_, storage_);
+      other.ops_ = nullptr;
+    }
+    return *this;
+  }
+
+  ~task() { reset(); }
+
+  explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+  auto operator()() -> void { ops_->invoke(storage_); }
+
+  auto reset() noexcept -> void
+  {
+    if (ops_ != nullptr)
+      ops_->destroy(storage_);
+    ops_ = nullptr;
+  }
+
+  // When the task was queued, if it is timed; kept beside the callable so that
+  // timing doesn't take the inline storage.
+  auto enqueued() const noexcept -> std::chrono::steady_clock::time_point { return enqueued_; }
+  auto set_enqueued(std::chrono::steady_clock::time_point time) noexcept -> void { enqueued_ = time; }
+
+private:
+  static constexpr std::size_t buffer_size = 6 * sizeof(void*);
+
+  struct operations {
+    void (*invoke)(void*);
+    void (*move)(void* from, void* to);
+    void (*destroy)(void*);
+  };
+
+  template <typename F> static constexpr auto fits_inline() -> bool
+  {
+    return sizeof(F) <= buffer_size && alignof(F) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible<F>::value;
+  }
+
+  template <typename F> struct inline_operations {
+    static auto invoke(void* p) -> void { (*static_cast<F*>(p))(); }
+
+    static auto move(void* from, void* to) -> void
+    {
+      ::new (to) F(std::move(*static_cast<F*>(from)));
+      static_cast<F*>(from)->~F();
+    }
+
+    static auto destroy(void* p) -> void { static_cast<F*>(p)->~F(); }
+  };
+
+  template <typename F> struct heap_operations {
+    static auto invoke(void* p) -> void { (**static_cast<F**>(p))(); }
+    static auto move(void* from, void* to) -> void { *static_cast<F**>(to) = *static_cast<F**>(from); }
+    static auto destroy(void* p) -> void { delete *static_cast<F**>(p); }
+  };
+
+  template <typename F, typename Arg> auto store(Arg&& f, std::true_type) -> const operations*
+  {
+    static const operations ops{&inline_operations<F>::invoke, &inline_operations<F>::move, &inline_operations<F>::destroy};
+    ::new (static_cast<void*>(storage_)) F(std::forward<Arg>(f));
+    return &ops;
+  }
+
+  template <typename F, typename Arg> auto store(Arg&& f, std::false_type) -> const operations*
+  {
+    static const operations ops{&heap_operations<F>::invoke, &heap_operations<F>::move, &heap_operations<F>::destroy};
+    *reinterpret_cast<F**>(storage_) = new F(std::forward<Arg>(f));
+    return &ops;
+  }
+
+  const operations* ops_ = nullptr;
+  std::chrono::steady_clock::time_point enqueued_;
+  alignas(std::max_align_t) unsigned char storage_[buffer_size];
+};
+
+// Completion of a group of tasks: the future is ready once every unit of work
+// is done, and holds the first exception thrown, if any.
+class group_completion
+{
+public:
+  explicit group_completion(std::size_t count) : remaining_{count} {}
+
+  auto get_future() -> std::future<void> { return promise_.get_future(); }
+
+  // Sets the number of units of work, before any of them is done.
+  auto expect(std::size_t count) noexcept -> void { remaining_.store(count, std::memory_order_relaxed); }
+
+  template <typename G> auto guard(G&& g) noexcept -> void
+  {
+    try {
+      g();
+    } catch (...) {
+      fail(std::current_exception());
+    }
+  }
+
+  auto fail(std::exception_ptr error) noexcept -> void
+  {
+    if (!failed_.exchange(true, std::memory_order_relaxed))
+      error_ = std::move(error);
+  }
+
+  auto done(std::size_t count = 1) -> void
+  {
+    if (remaining_.fetch_sub(count, std::memory_order_acq_rel) != count)
+      return;
+
+    if (error_)
+      promise_.set_exception(error_);
+    else
+      promise_.set_value();
+  }
+
+private:
+  std::promise<void> promise_;
+  std::atomic<std::size_t> remaining_;
+  std::atomic<bool> failed_{false};
+  std::exception_ptr error_;
+};
+
+template <typename F> struct group_state : group_completion {
+  group_state(std::size_t count, F f) : group_completion{count}, f(std::move(f)) {}
+
+  F f;
+};
+
+// FIFO queues of tasks, one per priority.  Each time a non-empty queue is
+// passed over for a higher priority one, it ages; once it aged enough, it is
+// served next.
+class task_queues
+{
+public:
+  static constexpr std::size_t levels = 3;
+  static constexpr unsigned aging = 32;
+
+  auto empty() const noexcept -> bool { return size_ == 0; }
+  auto size() const noexcept -> std::size_t { return size_; }
+  auto urgent() const noexcept -> std::size_t { return queues_[0].size(); }
+
+  auto push(task t, task_priority priority) -> void
+  {
+    queues_[static_cast<std::size_t>(priority)].push(std::move(t));
+    ++size_;
+  }
+
+  // Only if not empty.
+  auto pop() -> task
+  {
+    auto highest = std::size_t{0};
+    while (queues_[highest].empty())
+      ++highest;
+
+    auto level = highest;
+    for (auto i = highest + 1; i < levels; ++i) {
+      if (!queues_[i].empty() && skipped_[i] >= aging) {
+        level = i;
+        break;
+      }
+    }
+
+    for (auto i = highest + 1; i < levels; ++i) {
+      if (i != level && !queues_[i].empty())
+        ++skipped_[i];
+    }
+    skipped_[level] = 0;
+
+    auto t = std::move(queues_[level].front());
+    queues_[level].pop();
+    --size_;
+    return t;
+  }
+
+private:
+  std::queue<task> queues_[levels];
+  unsigned skipped_[levels] = {};
+  std::size_t size_ = 0;
+};
+
+// Duration histogram whose buckets can be incremented concurrently.
+class atomic_histogram
+{
+public:
+  atomic_histogram() noexcept { reset(); }
+
+  auto record(std::chrono::nanoseconds d) noexcept -> void
+  {
+    const auto ns = static_cast<std::uint64_t>(std::max(d.count(), std::chrono::nanoseconds::rep{1}));
+    auto bucket = std::size_t{0};
+    while (bucket + 1 < duration_histogram::buckets && (ns >> (bucket + 1)) != 0)
+      ++bucket;
+    counts_[bucket].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  auto reset() noexcept -> void
+  {
+    for (auto& count : counts_)
+      count.store(0, std::memory_order_relaxed);
+  }
+
+  auto snapshot() const noexcept -> duration_histogram
+  {
+    auto histogram = duration_histogram{};
+    for (auto i = std::size_t{0}; i < duration_histogram::buckets; ++i)
+      histogram.counts[i] = counts_[i].load(std::memory_order_relaxed);
+    return histogram;
+  }
+
+private:
+  std::atomic<std::uint64_t> counts_[duration_histogram::buckets];
+};
+
+// Statistics of a single worker.  Times are guarded by the lock of the pool.
+struct worker_counters {
+  explicit worker_counters(std::size_t index) noexcept : index{index}, started{std::chrono::steady_clock::now()} {}
+
+  const std::size_t index;
+  std::atomic<std::uint64_t> tasks{0};
+  std::atomic<std::uint64_t> steals{0};
+  std::atomic<std::int64_t> busy{0};
+  std::chrono::steady_clock::time_point started;
+  std::chrono::steady_clock::time_point retired;
+};
+
+template <typename T> class future_state;
+
+} // namespace detail
+
+template <typename T> class task_future;
+template <typename T> struct when_any_result;
+
 class thread_pool
 {
 public:
-  explicit thread_pool(std::size_t nthreads = 0)
+  explicit thread_pool(std::size_t nthreads = 0, wait_strategy strategy = wait_strategy::block())
+    : thread_pool(nthreads, scheduling::shared_queue, strategy)
+  {
+  }
+
+  thread_pool(std::size_t nthreads, scheduling mode, wait_strategy strategy = wait_strategy::block())
+    : thread_pool(nthreads, worker_placement::anywhere(), mode, strategy)
+  {
+  }
+
+  /// Constructs a pool whose workers are placed on CPUs according to `where`.
+  ///
+  /// If `nthreads` is zero, there is one worker per CPU of the placement.
+  thread_pool(std::size_t nthreads, const worker_placement& where, scheduling mode = scheduling::shared_queue,
+              wait_strategy strategy = wait_strategy::block())
+    : strategy_{strategy}, node_tasks_(where.groups()), node_workers_(where.groups()), node_idle_(where.groups()),
+      node_cvs_(where.groups())
+  {
+    if (nthreads == 0)
+      nthreads = where.groups() > 0 ? where.cpus() : std::thread::hardware_concurrency();
+
+    if (mode == scheduling::work_stealing) {
+      for (auto i : indices(nthreads))
+        locals_.emplace_back(new local_queue{0x9e3779b97f4a7c15u * (i + 1)});
+    }
+
+    live_ = nthreads;
+    for (auto i : indices(nthreads)) {
+      const auto slot = where.slot_of(i);
+      if (slot.group < node_workers_.size())
+        ++node_workers_[slot.group];
+      auto* counters = add_counters();
+      workers_.emplace_back([this, i, slot, mode, counters] {
+        worker_placement::pin(slot.cpus);
+        if (mode == scheduling::work_stealing)
+          steal_work(i, slot.group, counters);
+        else
+          share_work(slot.group, counters);
+      });
+    }
+  }
+
+  /// Constructs an elastic pool, whose number of workers varies within `limits`.
+  ///
+  /// \notes Elastic pools use a shared queue.
+  /// \notes Throws `std::invalid_argument` if `limits.max_threads` is zero or less than
+  ///        `limits.min_threads`.
+  explicit thread_pool(const elastic_limits& limits, wait_strategy strategy = wait_strategy::block())
+    : strategy_{strategy}, elastic_{true}, min_threads_{limits.min_threads}, max_threads_{limits.max_threads},
+      idle_timeout_{limits.idle_timeout}
+  {
+    if (max_threads_ == 0 || max_threads_ < min_threads_)
+      throw std::invalid_argument{"invalid elastic thread_pool limits"};
+
+    auto exited = std::vector<std::thread>();
+    auto l = lock();
+    while (live_ < min_threads_)
+      spawn(exited);
+  }
+
+  thread_pool(const thread_pool&) = delete;
+  thread_pool(thread_pool&&) = delete;
+
+  auto operator=(const thread_pool&) -> thread_pool& = delete;
+  auto operator=(thread_pool&&) -> thread_pool& = delete;
+
+  template <typename F, typename... Args> auto enqueue(F&& f, Args&&... args) -> std::future<RESULT_OF_T(F&&, Args&&...)>
+  {
+    auto task = std::packaged_task<RESULT_OF_T(F&&, Args && ...)()>(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+    auto result = task.get_future();
+    submit(std::move(task));
+    return result;
+  }
+
+  /// Enqueues a task with the given priority.
+  template <typename F, typename... Args>
+  auto enqueue(task_priority priority, F&& f, Args&&... args) -> std::future<RESULT_OF_T(F&&, Args&&...)>
+  {
+    auto task = std::packaged_task<RESULT_OF_T(F&&, Args && ...)()>(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+    auto result = task.get_future();
+    submit(std::move(task), priority);
+    return result;
+  }
+
+  /// Enqueues a task on the workers of a group of the placement of the pool.
+  ///
+  /// Workers of the group run the task first.  While none of them is idle, other workers
+  /// may run it too.
+  ///
+  /// \notes If the pool has no such group, or no worker in that group, the task is enqueued
+  ///        on any worker.
+  template <typename F, typename... Args>
+  auto enqueue_on(std::size_t node, F&& f, Args&&... args) -> std::future<RESULT_OF_T(F&&, Args&&...)>
+  {
+    auto task = std::packaged_task<RESULT_OF_T(F&&, Args && ...)()>(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+    auto result = task.get_future();
+    submit_on(node, std::move(task));
+    return result;
+  }
+
+  /// Enqueues a task on the workers of a group of the placement of the pool, without creating
+  /// a future for its result.
+  template <typename F, typename... Args> auto post_on(std::size_t node, F&& f, Args&&... args) -> void
+  {
+    submit_on(node, std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+  }
+
+  /// Enqueues a task without creating a future for its result.
+  ///
+  /// Small tasks are stored inline in the queue, so posting them doesn't allocate.
+  ///
+  /// \notes An exception escaping a posted task calls `std::terminate`.
+  template <typename F, typename... Args> auto post(F&& f, Args&&... args) -> void
+  {
+    submit(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+  }
+
+  /// Enqueues a task with the given priority, without creating a future for its result.
+  template <typename F, typename... Args> auto post(task_priority priority, F&& f, Args&&... args) -> void
+  {
+    submit(std::bind(std::forward<F>(f), std::forward<Args>(args)...), priority);
+  }
+
+  /// Enqueues a task and returns a future whose continuations run on this pool.
+  ///
+  /// \notes Unlike `enqueue`, chaining tasks with `task_future::then` doesn't block a worker
+  ///        while the previous task runs.
+  template <typename F, typename... Args> auto async(F&& f, Args&&... args) -> task_future<RESULT_OF_T(F&&, Args&&...)>;
+
+  /// Enqueues a task calling `f` on each element of `range`.
+  ///
+  /// Returns a future that is ready once every call returned.  If calls throw, it holds
+  /// the first exception thrown.
+  ///
+  /// \notes All tasks are enqueued at once, taking the lock of the pool only once.
+  template <typename Range, typename F> auto enqueue_bulk(Range&& range, F f) -> std::future<void>
+  {
+    auto tasks = std::vector<task_t>();
+    auto state = std::make_shared<detail::group_state<F>>(0, std::move(f));
+
+    for (auto&& x : range) {
+      using value_t = typename std::decay<decltype(x)>::type;
+      const auto& value = static_cast<const value_t&>(x);
+      tasks.emplace_back([state, value]() mutable {
+        state->guard([&state, &value] { state->f(value); });
+        state->done();
+      });
+    }
+
+    state->expect(tasks.size());
+    return submit_group(state, std::move(tasks));
+  }
+
+  /// Calls `f(i)` for each index of `range`, in chunks of at least `grain` indices.
+  ///
+  /// Returns a future that is ready once every call returned.  If calls throw, it holds
+  /// the first exception thrown, and the chunks that threw are not completed.
+  ///
+  /// \notes With work stealing, the range is split in halves recursively by the workers,
+  ///        so that idle workers steal large chunks.  With a shared queue, all chunks are
+  ///        enqueued at once.
+  template <typename T, typename F>
+  auto parallel_for(const index_range<T>& range, F f, std::size_t grain = 1) -> std::future<void>
+  {
+    if (grain == 0)
+      grain = 1;
+
+    const auto first = *range.begin();
+    const auto last = *range.end();
+    auto state = std::make_shared<detail::group_state<F>>(range.size(), std::move(f));
+
+    auto tasks = std::vector<task_t>();
+    if (!locals_.empty()) {
+      if (first != last)
+        tasks.emplace_back([this, state, first, last, grain] { split_loop(state, first, last, grain); });
+    } else {
+      for (auto begin = first; begin != last;) {
+        const auto end = static_cast<std::size_t>(last - begin) > grain ? static_cast<T>(begin + grain) : last;
+        tasks.emplace_back([state, begin, end] { run_loop(state, begin, end); });
+        begin = end;
+      }
+    }
+    return submit_group(state, std::move(tasks));
+  }
+
+  /// Closes the pool and waits for its workers to finish, either draining or dropping the
+  /// queued tasks.
+  auto join(shutdown_policy policy = shutdown_policy::drain) -> void
+  {
+    close();
+    if (policy == shutdown_policy::cancel_pending)
+      cancel_pending();
+    join_workers();
+  }
+
+  /// Closes the pool and waits for its workers to run the queued tasks, until `rel` elapsed.
+  /// Tasks that didn't start by then are dropped, as with `shutdown_policy::cancel_pending`.
+  ///
+  /// Returns `true` if all tasks ran.
+  template <typename Rep, typename Period> auto join_for(const std::chrono::duration<Rep, Period>& rel) -> bool
+  {
+    return join_until(std::chrono::steady_clock::now() + rel);
+  }
+
+  /// Closes the pool and waits for its workers to run the queued tasks, until `time`.
+  /// Tasks that didn't start by then are dropped, as with `shutdown_policy::cancel_pending`.
+  ///
+  /// Returns `true` if all tasks ran.
+  template <typename Clock, typename Duration> auto join_until(const std::chrono::time_point<Clock, Duration>& time) -> bool
+  {
+    close();
+    auto drained = false;
+    {
+      auto l = lock();
+      drained = no_workers_.wait_until(l, time, [this] { return live_ == 0; });
+    }
+    if (!drained)
+      cancel_pending();
+    join_workers();
+    return drained;
+  }
+
+  /// Drops the tasks that didn't start, and cancels the token of the pool.
+  ///
+  /// Returns the number of dropped tasks.  The futures of dropped tasks hold a
+  /// `std::future_error` with the `broken_promise` error code.
+  ///
+  /// \notes If the pool is still open, `token` returns a fresh token afterwards, so that
+  ///        tasks enqueued later aren't cancelled.  Tokens taken before stay cancelled.
+  auto cancel_pending() -> std::size_t
+  {
+    auto dropped = std::vector<task_t>();
+    {
+      auto l = lock();
+      cancellation_.cancel();
+      if (!closed_)
+        cancellation_ = cancellation_source{};
+
+      while (!tasks_.empty())
+        dropped.push_back(tasks_.pop());
+      for (auto& queue : node_tasks_)
+        while (!queue.empty())
+          dropped.push_back(queue.pop());
+      node_queued_ = 0;
+      update_hints();
+      room_.notify_all();
+    }
+
+    for (const auto& local : locals_) {
+      while (!local->deque.empty()) {
+        if (auto* t = local->deque.steal()) {
+          dropped.push_back(std::move(*t));
+          delete t;
+        }
+      }
+    }
+
+    // Dropping tasks breaks their promises, which may run continuations: do it
+    // without holding the lock.
+    const auto count = dropped.size();
+    dropped.clear();
+    return count;
+  }
+
+  /// Returns a token cancelled by the next `cancel_pending`, directly or through a shutdown.
+  auto token() const -> cancellation_token
+  {
+    auto l = lock();
+    return cancellation_.token();
+  }
+
+  auto detach() -> void
+  {
+    auto l = lock();
+    detached_ = true;
+    for (auto& worker : workers_)
+      if (worker.joinable())
+        worker.detach();
+  }
+
+  auto joinable() const noexcept -> bool
+  {
+    auto l = lock();
+    return !detached_ && !joined_;
+  }
+
+  auto close() noexcept -> void
+  {
+    auto l = lock();
+    closed_ = true;
+    wake_all();
+    room_.notify_all();
+  }
+
+  /// Bounds the shared queue to `capacity` tasks, zero meaning unbounded, and sets what
+  /// happens to tasks submitted while it is full.
+  ///
+  /// \notes With work stealing, tasks that workers push to their own deque are not bounded.
+  /// \notes Tasks of `enqueue_bulk` and `parallel_for` are queued one by one; unless `policy`
+  ///        is `block`, those that don't fit run on the calling thread.  So do continuations of
+  ///        `task_future`, whatever the policy.
+  auto set_queue_limit(std::size_t capacity, overflow_policy policy = overflow_policy::block) -> void
+  {
+    auto l = lock();
+    capacity_ = capacity;
+    overflow_.store(policy, std::memory_order_relaxed);
+    room_.notify_all();
+  }
+
+  auto is_closed() const noexcept -> bool
+  {
+    auto l = lock();
+    return closed_;
+  }
+
+  /// Waits for `future` to be ready, running queued tasks of the pool meanwhile.
+  ///
+  /// Unlike `future.wait()`, this doesn't hold up a worker, so tasks can wait for the tasks
+  /// they enqueued without exhausting the pool.
+  ///
+  /// \notes `Future` can be a `std::future`, a `std::shared_future` or a `task_future`.
+  /// \notes From a thread that isn't a worker of the pool, only tasks of the shared queue
+  ///        are run.
+  /// \notes With a `task_future`, the thread sleeps while there is nothing to run, and
+  ///        wakes as soon as the future is ready or a task is queued.  Other futures can't
+  ///        signal their completion: they are polled every 50 microseconds, which costs
+  ///        some CPU while waiting and up to that much latency once ready.
+  template <typename Future> auto wait(const Future& future) -> void
+  {
+    while (future.wait_for(std::chrono::seconds{0}) != std::future_status::ready) {
+      if (!help())
+        future.wait_for(std::chrono::microseconds{50});
+    }
+  }
+
+  /// \exclude
+  template <typename T> auto wait(const task_future<T>& future) -> void;
+
+  /// Starts or stops collecting statistics, which are reset when starting.
+  ///
+  /// \notes While statistics are collected, each task costs a few more clock reads.
+  auto enable_stats(bool enabled = true) -> void
+  {
+    auto l = lock();
+    const auto now = std::chrono::steady_clock::now();
+    if (enabled) {
+      latency_.reset();
+      run_time_.reset();
+      tasks_run_.store(0, std::memory_order_relaxed);
+      overflows_ = 0;
+      for (const auto& counters : counters_) {
+        counters->tasks.store(0, std::memory_order_relaxed);
+        counters->steals.store(0, std::memory_order_relaxed);
+        counters->busy.store(0, std::memory_order_relaxed);
+      }
+      retired_stats_ = thread_pool_stats::worker{0, 0, std::chrono::nanoseconds{0}, std::chrono::nanoseconds{0}, false};
+      stats_since_ = now;
+    } else {
+      stats_until_ = now;
+    }
+    stats_enabled_.store(enabled, std::memory_order_relaxed);
+  }
+
+  /// Returns a snapshot of the statistics collected since `enable_stats`.
+  auto stats() const -> thread_pool_stats
+  {
+    auto result = thread_pool_stats{};
+    result.tasks = tasks_run_.load(std::memory_order_relaxed);
+    result.queue_latency = latency_.snapshot();
+    result.run_time = run_time_.snapshot();
+
+    auto l = lock();
+    result.overflows = overflows_;
+    result.queued = tasks_.size() + node_queued_;
+    for (const auto& local : locals_)
+      result.queued += local->deque.size();
+    result.threads = live_;
+
+    result.retired = retired_stats_;
+    for (const auto& counters : counters_)
+      result.workers.push_back(snapshot(*counters));
+    return result;
+  }
+
+  /// Sets a function called by workers after each task, such as a `chrome_trace`.
+  ///
+  /// An empty function stops tracing.
+  ///
+  /// \notes Only tasks enqueued while a hook is set are traced.
+  auto set_trace_hook(std::function<void(const task_event&)> hook) -> void
+  {
+    auto shared = hook ? std::make_shared<const std::function<void(const task_event&)>>(std::move(hook)) : nullptr;
+    auto l = std::unique_lock<std::mutex>(hook_mutex_);
+    hook_.swap(shared);
+    tracing_.store(hook_ != nullptr, std::memory_order_relaxed);
+    l.unlock();
+  }
+
+  /// Returns the number of running workers.
+  auto thread_count() const -> std::size_t
+  {
+    auto l = lock();
+    return live_;
+  }
+
+  /// Returns the number of groups of workers that tasks can be enqueued on, zero if the
+  /// workers weren't placed.
+  auto nodes() const noexcept -> std::size_t { return node_tasks_.size(); }
+
+private:
+  template <typename T> friend class detail::future_state;
+  template <typename T> friend class task_future;
+
+  using task_t = detail::task;
+
+  struct local_queue {
+    explicit local_queue(std::uint64_t seed) : seed{seed} {}
+
+    detail::work_deque<task_t> deque;
+    std::uint64_t seed;
+  };
+
+  struct worker_context {
+    const thread_pool* pool;
+    local_queue* local;
+    std::size_t index;
+    std::size_t node;
+    detail::worker_counters* counters;
+  };
+
+  static auto current() noexcept -> worker_context&
+  {
+    static thread_local worker_context context{nullptr, nullptr, 0, 0, nullptr};
+    return context;
+  }
+
+  auto is_worker() const noexcept -> bool { return current().pool == this; }
+
+  // Stamps the task with the time it is queued, which times it when it runs.
+  auto instrument(task_t& task) -> void
+  {
+    if (stats_enabled_.load(std::memory_order_relaxed) || tracing_.load(std::memory_order_relaxed))
+      task.set_enqueued(std::chrono::steady_clock::now());
+  }
+
+  // Runs a task that went through `instrument`.
+  auto run_task(task_t& task) -> void
+  {
+    const auto enqueued = task.enqueued();
+    if (enqueued == std::chrono::steady_clock::time_point{})
+      return task();
+
+    const auto started = std::chrono::steady_clock::now();
+    task();
+    record(enqueued, started, std::chrono::steady_clock::now());
+  }
+
+  auto record(std::chrono::steady_clock::time_point enqueued, std::chrono::steady_clock::time_point started,
+              std::chrono::steady_clock::time_point finished) -> void
+  {
+    using std::chrono::duration_cast;
+    using std::chrono::nanoseconds;
+
+    const auto& context = current();
+    auto* counters = context.pool == this ? context.counters : nullptr;
+
+    if (stats_enabled_.load(std::memory_order_relaxed)) {
+      latency_.record(duration_cast<nanoseconds>(started - enqueued));
+      run_time_.record(duration_cast<nanoseconds>(finished - started));
+      tasks_run_.fetch_add(1, std::memory_order_relaxed);
+      if (counters != nullptr) {
+        counters->tasks.fetch_add(1, std::memory_order_relaxed);
+        counters->busy.fetch_add(duration_cast<nanoseconds>(finished - started).count(), std::memory_order_relaxed);
+      }
+    }
+
+    if (tracing_.load(std::memory_order_relaxed)) {
+      auto l = std::unique_lock<std::mutex>(hook_mutex_);
+      const auto hook = hook_;
+      l.unlock();
+      if (hook != nullptr)
+        (*hook)(task_event{counters != nullptr ? counters->index : static_cast<std::size_t>(-1), enqueued, started, finished});
+    }
+  }
+
+  // Without the lock held in constructors, with it otherwise.
+  auto add_counters() -> detail::worker_counters*
+  {
+    counters_.emplace_back(new detail::worker_counters{spawned_++});
+    return counters_.back().get();
+  }
+
+  // With the lock held.  Counters of workers that retired are no longer updated.
+  auto snapshot(const detail::worker_counters& counters) const -> thread_pool_stats::worker
+  {
+    using std::chrono::nanoseconds;
+
+    const auto until = stats_enabled_.load(std::memory_order_relaxed) ? std::chrono::steady_clock::now() : stats_until_;
+    const auto running = counters.retired == std::chrono::steady_clock::time_point{};
+    const auto begin = std::max(stats_since_, counters.started);
+    const auto end = running ? until : std::min(until, counters.retired);
+    const auto window = end > begin ? std::chrono::duration_cast<nanoseconds>(end - begin) : nanoseconds{0};
+    const auto busy = nanoseconds{counters.busy.load(std::memory_order_relaxed)};
+
+    return thread_pool_stats::worker{counters.tasks.load(std::memory_order_relaxed),
+                                     counters.steals.load(std::memory_order_relaxed), busy,
+                                     window > busy ? window - busy : nanoseconds{0}, running};
+  }
+
+  // With the lock held.  Adds the counters of retired workers to the retired
+  // totals, so that elastic pools only keep counters of running workers.
+  auto fold_retired() -> void
+  {
+    for (auto it = counters_.begin(); it != counters_.end();) {
+      if ((*it)->retired == std::chrono::steady_clock::time_point{}) {
+        ++it;
+        continue;
+      }
+
+      const auto worker = snapshot(**it);
+      retired_stats_.tasks += worker.tasks;
+      retired_stats_.steals += worker.steals;
+      retired_stats_.busy += worker.busy;
+      retired_stats_.idle += worker.idle;
+      it = counters_.erase(it);
+    }
+  }
+
+  // Runs queued tasks until `done()`, which is checked with the lock held.
+  // While there is nothing to run, sleeps as an idle worker would, also
+  // waking when helpers are notified.
+  template <typename Done> auto help_until(Done done) -> void
+  {
+    const auto& context = current();
+    const auto node = context.pool == this ? context.node : node_tasks_.size();
+    const auto steals = context.pool == this && context.local != nullptr;
+
+    while (true) {
+      {
+        auto l = lock();
+        if (done())
+          return;
+      }
+      if (help())
+        continue;
+
+      // Registering as a sleeper makes workers pushing to their deque wake us.
+      auto l = lock();
+      ++helpers_;
+      if (steals)
+        sleepers_.fetch_add(1);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      const auto epoch = epoch_;
+
+      if (!done() && !has_shared(node) && !(steals && has_stealable()))
+        strategy_.wait(help_cv_, l, [this, &done, node, epoch] { return done() || has_shared(node) || epoch_ != epoch; });
+
+      if (steals)
+        sleepers_.fetch_sub(1);
+      --helpers_;
+    }
+  }
+
+  // Runs a queued task, if any.  Workers look for tasks as they would between
+  // two tasks, other threads only take tasks from the shared queue.
+  auto help() -> bool
+  {
+    const auto context = current();
+    auto task = task_t();
+
+    if (context.pool == this && context.local != nullptr) {
+      if (!find_task(context.index, context.node, task))
+        return false;
+    } else {
+      const auto node = context.pool == this ? context.node : node_tasks_.size();
+      if (!take_shared(node, task))
+        return false;
+    }
+
+    run_task(task);
+    return true;
+  }
+
+  enum class admission { queued, closed, full };
+
+  auto submit(task_t task, task_priority priority = task_priority::normal) -> void
+  {
+    const auto policy = overflow_.load(std::memory_order_relaxed);
+    overflow(try_submit(task, priority, policy), policy, task);
+  }
+
+  // Leaves `task` untouched unless it was queued.  Only waits for room in the
+  // shared queue with `overflow_policy::block`.
+  auto try_submit(task_t& task, task_priority priority = task_priority::normal,
+                  overflow_policy policy = overflow_policy::caller_runs) -> admission
+  {
+    instrument(task);
+    auto* local = priority == task_priority::normal ? current_local() : nullptr;
+    if (local != nullptr) {
+      if (closed_)
+        return admission::closed;
+
+      local->deque.push(new task_t(std::move(task)));
+      wake_thief();
+      return admission::queued;
+    }
+
+    auto exited = std::vector<std::thread>();
+    auto woken = false;
+    {
+      auto lock = std::unique_lock<std::mutex>(mutex_);
+      const auto admitted = make_room(lock, policy);
+      if (admitted != admission::queued)
+        return admitted;
+
+      tasks_.push(std::move(task), priority);
+      update_hints();
+      grow(exited);
+      woken = wake_idle_node();
+    }
+    if (!woken)
+      cv_.notify_one();
+    join_exited(exited);
+    return admission::queued;
+  }
+
+  // Handles a task submitted with `policy` that wasn't queued.
+  auto overflow(admission admitted, overflow_policy policy, task_t& task) -> void
+  {
+    if (admitted == admission::closed)
+      throw closed_thread_pool{std::make_error_code(std::errc::invalid_argument), "enqueue on closed thread_pool"};
+    if (admitted == admission::full) {
+      if (policy == overflow_policy::reject)
+        throw full_thread_pool{std::make_error_code(std::errc::resource_unavailable_try_again), "enqueue on full thread_pool"};
+      run_task(task);
+    }
+  }
+
+  // With the lock held.  Checks whether a task can join the shared queue,
+  // waiting for room if it is full and `policy` is `block`.  Workers don't
+  // wait, as they might be the ones to make room.
+  auto make_room(std::unique_lock<std::mutex>& l, overflow_policy policy) -> admission
+  {
+    if (closed_)
+      return admission::closed;
+    if (!is_full())
+      return admission::queued;
+
+    ++overflows_;
+    if (policy != overflow_policy::block || is_worker())
+      return admission::full;
+
+    wake_queued();
+    ++room_waiters_;
+    strategy_.wait(room_, l, [this] { return closed_ || !is_full(); });
+    --room_waiters_;
+    return closed_ ? admission::closed : admission::queued;
+  }
+
+  // With the lock held.
+  auto is_full() const noexcept -> bool { return capacity_ != 0 && tasks_.size() + node_queued_ >= capacity_; }
+
+  auto submit_on(std::size_t node, task_t task) -> void
+  {
+    auto* queue = node_queue(node);
+    if (queue == nullptr || node_workers_[node] == 0)
+      return submit(std::move(task));
+
+    instrument(task);
+    const auto policy = overflow_.load(std::memory_order_relaxed);
+    {
+      auto l = lock();
+      const auto admitted = make_room(l, policy);
+      if (admitted != admission::queued) {
+        l.unlock();
+        return overflow(admitted, policy, task);
+      }
+
+      queue->push(std::move(task), task_priority::normal);
+      ++node_queued_;
+      update_hints();
+      wake_node(node);
+    }
+  }
+
+  // Runs `task` on the pool, or right here if the pool is closed or full.
+  auto schedule(task_t task) -> void
+  {
+    if (try_submit(task) != admission::queued)
+      run_task(task);
+  }
+
+  template <typename State> auto submit_group(const std::shared_ptr<State>& state, std::vector<task_t> tasks) -> std::future<void>
+  {
+    auto result = state->get_future();
+    if (tasks.empty()) {
+      state->done(0);
+      return result;
+    }
+
+    for (auto& task : tasks)
+      instrument(task);
+
+    if (auto* local = current_local()) {
+      if (closed_)
+        throw closed_thread_pool{std::make_error_code(std::errc::invalid_argument), "enqueue on closed thread_pool"};
+
+      for (auto& task : tasks)
+        local->deque.push(new task_t(std::move(task)));
+      wake_thief();
+      return result;
+    }
+
+    // Tasks that don't fit in the shared queue, or that come after it is closed
+    // meanwhile, run here.
+    const auto policy = overflow_.load(std::memory_order_relaxed) == overflow_policy::block ? overflow_policy::block
+                                                                                            : overflow_policy::caller_runs;
+    auto rest = tasks.end();
+    auto exited = std::vector<std::thread>();
+    {
+      auto lock = std::unique_lock<std::mutex>(mutex_);
+      for (auto it = tasks.begin(); it != tasks.end(); ++it) {
+        const auto admitted = make_room(lock, policy);
+        if (admitted == admission::closed && it == tasks.begin())
+          throw closed_thread_pool{std::make_error_code(std::errc::invalid_argument), "enqueue on closed thread_pool"};
+        if (admitted != admission::queued) {
+          rest = it;
+          break;
+        }
+        tasks_.push(std::move(*it), task_priority::normal);
+        update_hints();
+        grow(exited);
+      }
+    }
+    wake_all();
+    join_exited(exited);
+
+    for (; rest != tasks.end(); ++rest)
+      run_task(*rest);
+    return result;
+  }
+
+  // Runs `[begin, end)`, handing its upper halves to other workers while it is
+  // larger than `grain`.  If the pool is closed meanwhile, the rest runs here.
+  template <typename State, typename T>
+  auto split_loop(const std::shared_ptr<State>& state, T begin, T end, std::size_t grain) -> void
+  {
+    while (static_cast<std::size_t>(end - begin) > grain) {
+      const auto mid = static_cast<T>(begin + (end - begin) / 2);
+      auto upper = task_t([this, state, mid, end, grain] { split_loop(state, mid, end, grain); });
+      if (try_submit(upper) != admission::queued)
+        break;
+      end = mid;
+    }
+    run_loop(state, begin, end);
+  }
+
+  template <typename State, typename T> static auto run_loop(const std::shared_ptr<State>& state, T begin, T end) -> void
+  {
+    state->guard([&state, begin, end] {
+      for (auto i = begin; i != end; ++i)
+        state->f(i);
+    });
+    state->done(static_cast<std::size_t>(end - begin));
+  }
+
+  auto current_local() const noexcept -> local_queue*
+  {
+    const auto& context = current();
+    return context.pool == this ? context.local : nullptr;
+  }
+
+  auto join_workers() -> void
+  {
+    for (auto& worker : workers_)
+      if (worker.joinable())
+        worker.join();
+
+    auto l = lock();
+    joined_ = true;
+  }
+
+  // With the lock held, when a worker exits.
+  auto retire(detail::worker_counters* counters) -> void
+  {
+    counters->retired = std::chrono::steady_clock::now();
+    if (--live_ == 0)
+      no_workers_.notify_all();
+  }
+
+  // Worker loop of the shared queue mode.
+  auto share_work(std::size_t node, detail::worker_counters* counters) -> void
+  {
+    current() = worker_context{this, nullptr, 0, node, counters};
+    while (true) {
+      auto task = task_t();
+      {
+        auto l = lock();
+        idle_on(node, true);
+        strategy_.wait(worker_cv(node), l, [this, node] { return closed_ || has_shared(node); });
+        idle_on(node, false);
+
+        if (closed_ && !has_shared(node)) {
+          retire(counters);
+          return;
+        }
+
+        task = pop_shared(node);
+      }
+      run_task(task);
+    }
+  }
+
+  // Worker loop of elastic pools.  Workers count as idle while they don't run
+  // a task, and retire once idle for too long.
+  auto elastic_work(detail::worker_counters* counters) -> void
+  {
+    current() = worker_context{this, nullptr, 0, 0, counters};
+    auto l = lock();
+    while (true) {
+      const auto deadline = std::chrono::steady_clock::now() + idle_timeout_;
+      const auto woken = strategy_.wait_until(cv_, l, deadline, [this] { return closed_ || !tasks_.empty(); });
+
+      if (!tasks_.empty()) {
+        --idle_;
+        {
+          auto task = pop_shared(0);
+          l.unlock();
+          run_task(task);
+        }
+        l.lock();
+        ++idle_;
+        continue;
+      }
+
+      if (closed_ || (!woken && live_ > min_threads_)) {
+        --idle_;
+        retire(counters);
+        retired_.push_back(std::this_thread::get_id());
+        return;
+      }
+    }
+  }
+
+  // With the lock held.  Starts a worker of an elastic pool, after moving the
+  // threads of the workers that retired to `exited`, to be joined once the
+  // lock is released.
+  auto spawn(std::vector<std::thread>& exited) -> void
+  {
+    if (!retired_.empty()) {
+      auto kept = workers_.begin();
+      for (auto it = workers_.begin(); it != workers_.end(); ++it) {
+        if (!it->joinable())
+          continue;
+        if (std::find(retired_.begin(), retired_.end(), it->get_id()) != retired_.end()) {
+          exited.push_back(std::move(*it));
+          continue;
+        }
+        if (kept != it)
+          *kept = std::move(*it);
+        ++kept;
+      }
+      workers_.erase(kept, workers_.end());
+      retired_.clear();
+    }
+    fold_retired();
+
+    auto* counters = add_counters();
+    workers_.emplace_back([this, counters] { elastic_work(counters); });
+    if (detached_)
+      workers_.back().detach();
+    ++live_;
+    ++idle_;
+  }
+
+  // With the lock held.  Growth is only evaluated when tasks are submitted:
+  // workers blocked in running tasks start no new workers by themselves, the
+  // next submission does.
+  auto grow(std::vector<std::thread>& exited) -> void
   {
-    if (nthreads == 0)
-      nthreads = std::thread::hardware_concurrency();
+    while (elastic_ && tasks_.size() > idle_ && live_ < max_threads_)
+      spawn(exited);
+  }
+
+  // Joins threads of retired workers, without the lock held.
+  static auto join_exited(std::vector<std::thread>& exited) -> void
+  {
+    for (auto& worker : exited)
+      worker.join();
+  }
 
-    for (auto _ : indices(nthreads)) {
-      (void)_;
+  // Worker loop of the work-stealing mode.  Before going to sleep, a worker
+  // registers as a sleeper and checks every queue once more, while workers
+  // pushing to their deque check for sleepers: either the pusher sees the
+  // sleeper and wakes it, or the sleeper sees the task.
+  auto steal_work(std::size_t index, std::size_t node, detail::worker_counters* counters) -> void
+  {
+    auto& self = *locals_[index];
+    current() = worker_context{this, &self, index, node, counters};
 
-      workers_.emplace_back([this] {
-        while (true) {
-          auto task = std::function<void()>();
-          {
-            auto lock = std::unique_lock<std::mutex>(mutex_);
-            cv_.wait(lock, [this] { return closed_ || !tasks_.empty(); });
+    auto task = task_t();
+    while (true) {
+      if (find_task(index, node, task)) {
+        run_task(task);
+        task.reset();
+        continue;
+      }
 
-            if (closed_ && tasks_.empty())
-              return;
+      auto l = lock();
+      sleepers_.fetch_add(1);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      const auto epoch = epoch_;
 
-            task = std::move(tasks_.front());
-            tasks_.pop();
-          }
-          task();
+      if (!has_shared(node) && !has_stealable()) {
+        if (closed_) {
+          sleepers_.fetch_sub(1);
+          retire(counters);
+          return;
         }
-      });
+        idle_on(node, true);
+        strategy_.wait(worker_cv(node), l, [this, node, epoch] { return closed_ || has_shared(node) || epoch_ != epoch; });
+        idle_on(node, false);
+      }
+      sleepers_.fetch_sub(1);
     }
   }
 
-  thread_pool(const thread_pool&) = delete;
-  thread_pool(thread_pool&&) = delete;
+  auto find_task(std::size_t index, std::size_t node, task_t& task) -> bool
+  {
+    auto& self = *locals_[index];
+    if (urgent_.load(std::memory_order_relaxed) > 0 && take_shared(node, task))
+      return true;
 
-  auto operator=(const thread_pool&) -> thread_pool& = delete;
-  auto operator=(thread_pool&&) -> thread_pool& = delete;
+    if (auto* t = self.deque.take())
+      return run_later(t, task);
 
-  template <typename F, typename... Args> auto enqueue(F&& f, Args&&... args) -> std::future<RESULT_OF_T(F&&, Args&&...)>
+    if (queued_.load(std::memory_order_relaxed) > 0 && take_shared(node, task))
+      return true;
+
+    // xorshift64 picks where to start looking for a victim.
+    self.seed ^= self.seed << 13;
+    self.seed ^= self.seed >> 7;
+    self.seed ^= self.seed << 17;
+
+    const auto n = locals_.size();
+    const auto start = static_cast<std::size_t>(self.seed % n);
+    for (auto i : indices(n)) {
+      const auto victim = (start + i) % n;
+      if (victim == index)
+        continue;
+      if (auto* t = locals_[victim]->deque.steal()) {
+        if (auto* counters = current().counters)
+          counters->steals.fetch_add(1, std::memory_order_relaxed);
+        return run_later(t, task);
+      }
+    }
+    return false;
+  }
+
+  auto take_shared(std::size_t node, task_t& task) -> bool
   {
-    using ptask_t = std::packaged_task<RESULT_OF_T(F&&, Args && ...)()>;
+    auto l = lock();
+    if (!has_shared(node))
+      return false;
+    task = pop_shared(node);
+    return true;
+  }
 
-    auto task = std::make_shared<ptask_t>(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
-    auto result = task->get_future();
+  auto node_queue(std::size_t node) noexcept -> detail::task_queues*
+  {
+    return node < node_tasks_.size() ? &node_tasks_[node] : nullptr;
+  }
 
-    {
-      auto lock = std::unique_lock<std::mutex>(mutex_);
-      if (closed_)
-        throw closed_thread_pool{std::make_error_code(std::errc::invalid_argument), "enqueue on closed thread_pool"};
+  // With the lock held.  Workers waiting for tasks count as idle on their node.
+  // Once none is, the tasks of the node may go to workers of other nodes.
+  auto idle_on(std::size_t node, bool idle) noexcept -> void
+  {
+    if (node >= node_idle_.size())
+      return;
+    if (idle)
+      ++node_idle_[node];
+    else if (--node_idle_[node] == 0 && !node_tasks_[node].empty())
+      wake_idle_node();
+  }
+
+  // With the lock held.  Returns the queue of another node holding tasks that
+  // no idle worker of that node is about to take, if any.  Only workers of the
+  // pool take tasks of other nodes.
+  auto foreign_queue(std::size_t node) noexcept -> detail::task_queues*
+  {
+    if (node >= node_tasks_.size() || node_queued_ == 0)
+      return nullptr;
+    for (auto other : indices(node_tasks_.size()))
+      if (other != node && node_idle_[other] == 0 && !node_tasks_[other].empty())
+        return &node_tasks_[other];
+    return nullptr;
+  }
+
+  // With the lock held.
+  auto has_shared(std::size_t node) noexcept -> bool
+  {
+    auto* queue = node_queue(node);
+    return !tasks_.empty() || (queue != nullptr && !queue->empty()) || foreign_queue(node) != nullptr;
+  }
+
+  // With the lock held, only if `has_shared(node)`.  Tasks of the node of the
+  // worker go first, then tasks of the shared queue, then tasks of other nodes.
+  auto pop_shared(std::size_t node) -> task_t
+  {
+    auto* queue = node_queue(node);
+    if (queue == nullptr || queue->empty())
+      queue = tasks_.empty() ? foreign_queue(node) : nullptr;
 
-      tasks_.emplace([task] { (*task)(); });
+    auto task = task_t();
+    if (queue != nullptr) {
+      task = queue->pop();
+      --node_queued_;
+    } else {
+      task = tasks_.pop();
     }
-    cv_.notify_one();
+    update_hints();
+    if (room_waiters_ > 0)
+      room_.notify_one();
+    return task;
+  }
 
-    return result;
+  // With the lock held, after the shared queues changed.
+  auto update_hints() noexcept -> void
+  {
+    queued_.store(tasks_.size() + node_queued_, std::memory_order_relaxed);
+    urgent_.store(tasks_.urgent(), std::memory_order_relaxed);
+    if (helpers_ > 0 && (!tasks_.empty() || node_queued_ > 0))
+      help_cv_.notify_all();
   }
 
-  auto join() -> void
+  static auto run_later(task_t* t, task_t& task) -> bool
   {
-    close();
-    for (auto& worker : workers_)
-      worker.join();
+    task = std::move(*t);
+    delete t;
+    return true;
   }
 
-  auto detach() -> void
+  auto has_stealable() const noexcept -> bool
   {
-    for (auto& worker : workers_)
-      worker.detach();
+    for (const auto& local : locals_)
+      if (!local->deque.empty())
+        return true;
+    return false;
   }
 
-  auto joinable() const noexcept -> bool
+  auto wake_thief() -> void
   {
-    auto l = lock();
-    return workers_.back().joinable();
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers_.load(std::memory_order_relaxed) == 0)
+      return;
+
+    {
+      auto l = lock();
+      ++epoch_;
+      if (helpers_ > 0)
+        help_cv_.notify_all();
+      if (wake_idle_node())
+        return;
+    }
+    cv_.notify_one();
   }
 
-  auto close() noexcept -> void
+  // Workers of placed pools sleep on the condition variable of their node, so
+  // that tasks of a node only wake its workers.
+  auto worker_cv(std::size_t node) noexcept -> std::condition_variable&
   {
-    auto l = lock();
-    closed_ = true;
-    cv_.notify_all();
+    return node < node_cvs_.size() ? node_cvs_[node] : cv_;
   }
 
-  auto is_closed() const noexcept -> bool
+  // With the lock held, which makes sure that an idle worker is still waiting.
+  // Wakes an idle worker of some node, going round the nodes.  Returns false
+  // if the workers weren't placed or none is idle.
+  auto wake_idle_node() -> bool
   {
-    auto l = lock();
-    return closed_;
+    for (auto i : indices(node_cvs_.size())) {
+      const auto node = (next_wake_ + i) % node_cvs_.size();
+      if (node_idle_[node] > 0) {
+        next_wake_ = node + 1;
+        node_cvs_[node].notify_one();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // With the lock held.  Wakes a worker for a task of `node`: one of the node
+  // if any is idle, otherwise one of another node, which may take the task.
+  auto wake_node(std::size_t node) -> void
+  {
+    if (node_idle_[node] > 0)
+      node_cvs_[node].notify_one();
+    else
+      wake_idle_node();
+  }
+
+  // With the lock held.  Wakes workers for the tasks already queued.
+  auto wake_queued() -> void
+  {
+    for (auto node : indices(node_tasks_.size()))
+      if (!node_tasks_[node].empty())
+        wake_node(node);
+    if (!tasks_.empty() && !wake_idle_node())
+      cv_.notify_one();
+  }
+
+  auto wake_all() -> void
+  {
+    cv_.notify_all();
+    for (auto& cv : node_cvs_)
+      cv.notify_all();
   }
 
-private:
   auto lock() const -> std::unique_lock<std::mutex> { return std::unique_lock<std::mutex>(mutex_); }
 
-  std::queue<std::function<void()>> tasks_;
+  const wait_strategy strategy_;
+
+  detail::task_queues tasks_;
+  std::vector<detail::task_queues> node_tasks_;
+  std::vector<std::size_t> node_workers_;
+  std::vector<std::size_t> node_idle_;
+  std::vector<std::condition_variable> node_cvs_;
+  std::size_t next_wake_ = 0;
+  std::size_t node_queued_ = 0;
   std::vector<std::thread> workers_;
+  std::vector<std::unique_ptr<local_queue>> locals_;
 
   std::condition_variable cv_;
+  std::condition_variable no_workers_;
+  mutable std::mutex mutex_;
+
+  std::size_t capacity_ = 0;
+  std::atomic<overflow_policy> overflow_{overflow_policy::block};
+  std::condition_variable room_;
+  std::size_t room_waiters_ = 0;
+
+  std::condition_variable help_cv_;
+  std::size_t helpers_ = 0;
+  std::uint64_t overflows_ = 0;
+
+  const bool elastic_ = false;
+  const std::size_t min_threads_ = 0;
+  const std::size_t max_threads_ = 0;
+  const std::chrono::milliseconds idle_timeout_{0};
+  std::size_t live_ = 0;
+  std::size_t idle_ = 0;
+  std::vector<std::thread::id> retired_;
+  bool detached_ = false;
+  bool joined_ = false;
+
+  std::vector<std::unique_ptr<detail::worker_counters>> counters_;
+  std::size_t spawned_ = 0;
+  thread_pool_stats::worker retired_stats_{0, 0, std::chrono::nanoseconds{0}, std::chrono::nanoseconds{0}, false};
+  std::atomic<bool> stats_enabled_{false};
+  std::chrono::steady_clock::time_point stats_since_;
+  std::chrono::steady_clock::time_point stats_until_;
+  std::atomic<std::uint64_t> tasks_run_{0};
+  detail::atomic_histogram latency_;
+  detail::atomic_histogram run_time_;
+
+  std::atomic<bool> tracing_{false};
+  std::mutex hook_mutex_;
+  std::shared_ptr<const std::function<void(const task_event&)>> hook_;
+
+  cancellation_source cancellation_;
+
+  std::atomic<bool> closed_{false};
+  std::atomic<std::size_t> sleepers_{0};
+  std::atomic<std::size_t> queued_{0};
+  std::atomic<std::size_t> urgent_{0};
+  std::uint64_t epoch_ = 0;
+};
+
+/// \exclude
+namespace detail
+{
+
+template <typename T> class future_storage
+{
+public:
+  future_storage() noexcept {}
+  future_storage(const future_storage&) = delete;
+  auto operator=(const future_storage&) -> future_storage& = delete;
+
+  ~future_storage()
+  {
+    if (engaged_)
+      value_.~T();
+  }
+
+  template <typename... Args> auto emplace(Args&&... args) -> void
+  {
+    ::new (static_cast<void*>(&value_)) T(std::forward<Args>(args)...);
+    engaged_ = true;
+  }
+
+  auto take() -> T { return std::move(value_); }
+
+private:
+  union {
+    T value_;
+  };
+  bool engaged_ = false;
+};
+
+template <> class future_storage<void>
+{
+public:
+  auto emplace() noexcept -> void {}
+  auto take() noexcept -> void {}
+};
+
+template <typename F, typename T> struct continuation_result {
+  using type = decltype(std::declval<F&>()(std::declval<T>()));
+};
+
+template <typename F> struct continuation_result<F, void> {
+  using type = decltype(std::declval<F&>()());
+};
+
+// Shared state of a task_future.  Once the state is ready, its continuations
+// are scheduled on the pool, or run right away if they are callbacks.
+template <typename T> class future_state
+{
+public:
+  explicit future_state(thread_pool* pool) noexcept : pool_{pool} {}
+
+  auto pool() const noexcept -> thread_pool* { return pool_; }
+
+  template <typename... Args> auto set_value(Args&&... args) -> void
+  {
+    auto l = std::unique_lock<std::mutex>(mutex_);
+    if (ready_)
+      return;
+    value_.emplace(std::forward<Args>(args)...);
+    complete(l);
+  }
+
+  auto set_exception(std::exception_ptr error) -> void
+  {
+    auto l = std::unique_lock<std::mutex>(mutex_);
+    if (ready_)
+      return;
+    error_ = std::move(error);
+    complete(l);
+  }
+
+  // Stores the outcome of `f(args...)`.
+  template <typename F, typename... Args> auto fulfil(F&& f, Args&&... args) -> void
+  {
+    try {
+      store(std::is_void<T>{}, f, std::forward<Args>(args)...);
+    } catch (...) {
+      set_exception(std::current_exception());
+    }
+  }
+
+  auto is_ready() const -> bool
+  {
+    auto l = std::unique_lock<std::mutex>(mutex_);
+    return ready_;
+  }
+
+  auto wait() const -> void
+  {
+    auto l = std::unique_lock<std::mutex>(mutex_);
+    cv_.wait(l, [this] { return ready_; });
+  }
+
+  template <typename Rep, typename Period> auto wait_for(const std::chrono::duration<Rep, Period>& rel) const -> bool
+  {
+    auto l = std::unique_lock<std::mutex>(mutex_);
+    return cv_.wait_for(l, rel, [this] { return ready_; });
+  }
+
+  // Only once the state is ready.
+  auto error() const noexcept -> const std::exception_ptr& { return error_; }
+
+  // Only once the state is ready, and only once.
+  auto take() -> T
+  {
+    if (error_)
+      std::rethrow_exception(error_);
+    return value_.take();
+  }
+
+  auto on_ready(task callback, bool scheduled) -> void
+  {
+    {
+      auto l = std::unique_lock<std::mutex>(mutex_);
+      if (!ready_) {
+        continuations_.push_back(continuation{std::move(callback), scheduled});
+        return;
+      }
+    }
+    run(continuation{std::move(callback), scheduled});
+  }
+
+private:
+  struct continuation {
+    task callback;
+    bool scheduled;
+  };
+
+  template <typename F, typename... Args> auto store(std::true_type, F& f, Args&&... args) -> void
+  {
+    f(std::forward<Args>(args)...);
+    set_value();
+  }
+
+  template <typename F, typename... Args> auto store(std::false_type, F& f, Args&&... args) -> void
+  {
+    set_value(f(std::forward<Args>(args)...));
+  }
+
+  auto complete(std::unique_lock<std::mutex>& l) -> void
+  {
+    ready_ = true;
+    auto continuations = std::move(continuations_);
+    l.unlock();
+    cv_.notify_all();
+
+    for (auto& c : continuations)
+      run(std::move(c));
+  }
+
+  auto run(continuation c) -> void
+  {
+    if (c.scheduled && pool_ != nullptr)
+      pool_->schedule(std::move(c.callback));
+    else
+      c.callback();
+  }
+
+  thread_pool* const pool_;
+
   mutable std::mutex mutex_;
+  mutable std::condition_variable cv_;
+  bool ready_ = false;
+
+  future_storage<T> value_;
+  std::exception_ptr error_;
+  std::vector<continuation> continuations_;
+};
+
+// Reference to a shared state from the task that will make it ready.  If the
+// task is dropped without running, the promise is broken.
+template <typename T> class promise_ref
+{
+public:
+  promise_ref(std::shared_ptr<future_state<T>> state) noexcept : state_{std::move(state)} {}
+  promise_ref(promise_ref&&) noexcept = default;
+
+  ~promise_ref()
+  {
+    if (state_ != nullptr)
+      state_->set_exception(std::make_exception_ptr(std::future_error{std::future_errc::broken_promise}));
+  }
+
+  auto operator->() const noexcept -> future_state<T>* { return state_.get(); }
+
+  // Once the state is ready.
+  auto release() noexcept -> void { state_.reset(); }
+
+private:
+  std::shared_ptr<future_state<T>> state_;
+};
+
+template <typename T, typename F> struct async_call {
+  auto operator()() -> void
+  {
+    state->fulfil(f);
+    state.release();
+  }
+
+  promise_ref<T> state;
+  F f;
+};
+
+template <typename R, typename T, typename F> struct then_call {
+  auto operator()() -> void
+  {
+    if (from->error())
+      to->set_exception(from->error());
+    else
+      forward(std::is_void<T>{});
+    to.release();
+  }
+
+  auto forward(std::true_type) -> void { to->fulfil(f); }
+  auto forward(std::false_type) -> void { to->fulfil(f, from->take()); }
+
+  std::shared_ptr<future_state<T>> from;
+  promise_ref<R> to;
+  F f;
+};
+
+template <typename T> struct when_all_result {
+  using type = std::vector<T>;
+};
+
+template <> struct when_all_result<void> {
+  using type = void;
+};
+
+} // namespace detail
+
+/// Result of a task run by a thread pool, to which continuations can be attached.
+///
+/// A `task_future` is move-only and can be consumed once, either by `get`, by `then`, or
+/// by `when_all` or `when_any`.
+///
+/// \notes Continuations are enqueued on the pool of the task once it completes, so no
+///        worker waits for a previous stage.  If the pool is closed by then, they run on the
+///        thread that completed the task.
+template <typename T> class task_future
+{
+public:
+  /// Constructs a future without a shared state.
+  task_future() noexcept = default;
+
+  /// \exclude
+  task_future(task_future&&) noexcept = default;
 
-  bool closed_ = false;
+  /// \exclude
+  auto operator=(task_future&&) noexcept -> task_future& = default;
+
+  /// Checks whether the future has a shared state.
+  auto valid() const noexcept -> bool { return state_ != nullptr; }
+
+  /// Checks whether the result is available.
+  auto is_ready() const -> bool { return checked_state()->is_ready(); }
+
+  /// Blocks until the result is available.
+  ///
+  /// \notes On a worker of the pool of the task, runs other tasks meanwhile, as
+  ///        `thread_pool::wait` does.
+  auto wait() const -> void
+  {
+    auto* pool = checked_state()->pool();
+    if (pool != nullptr && pool->is_worker())
+      pool->wait(*this);
+    state_->wait();
+  }
+
+  /// Blocks until the result is available, or `rel` elapsed.
+  template <typename Rep, typename Period>
+  auto wait_for(const std::chrono::duration<Rep, Period>& rel) const -> std::future_status
+  {
+    return checked_state()->wait_for(rel) ? std::future_status::ready : std::future_status::timeout;
+  }
+
+  /// Blocks until the result is available, then returns it or throws the exception of the
+  /// task.
+  ///
+  /// \notes On a worker of the pool of the task, runs other tasks meanwhile, as
+  ///        `thread_pool::wait` does.
+  auto get() -> T
+  {
+    wait();
+    return release()->take();
+  }
+
+  /// Attaches a continuation called with the result of the task.
+  ///
+  /// Returns a future of the result of `f`.  If the task threw, `f` isn't called and the
+  /// returned future holds the exception.
+  template <typename F> auto then(F f) -> task_future<typename detail::continuation_result<F, T>::type>
+  {
+    using result_t = typename detail::continuation_result<F, T>::type;
+
+    auto from = release();
+    auto to = std::make_shared<detail::future_state<result_t>>(from->pool());
+    from->on_ready(detail::then_call<result_t, T, F>{from, to, std::move(f)}, true);
+    return task_future<result_t>{std::move(to)};
+  }
+
+private:
+  template <typename U> friend class task_future;
+  friend class thread_pool;
+
+  template <typename U>
+  friend auto when_all(std::vector<task_future<U>> futures) -> task_future<typename detail::when_all_result<U>::type>;
+
+  template <typename U> friend auto when_any(std::vector<task_future<U>> futures) -> task_future<when_any_result<U>>;
+
+  explicit task_future(std::shared_ptr<detail::future_state<T>> state) noexcept : state_{std::move(state)} {}
+
+  auto checked_state() const -> detail::future_state<T>*
+  {
+    if (state_ == nullptr)
+      throw std::future_error{std::future_errc::no_state};
+    return state_.get();
+  }
+
+  auto release() -> std::shared_ptr<detail::future_state<T>>
+  {
+    checked_state();
+    return std::move(state_);
+  }
+
+  std::shared_ptr<detail::future_state<T>> state_;
+};
+
+template <typename F, typename... Args>
+auto thread_pool::async(F&& f, Args&&... args) -> task_future<RESULT_OF_T(F&&, Args&&...)>
+{
+  using result_t = RESULT_OF_T(F&&, Args&&...);
+  using call_t = decltype(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+
+  auto state = std::make_shared<detail::future_state<result_t>>(this);
+  submit(detail::async_call<result_t, call_t>{state, std::bind(std::forward<F>(f), std::forward<Args>(args)...)});
+  return task_future<result_t>{std::move(state)};
+}
+
+template <typename T> auto thread_pool::wait(const task_future<T>& future) -> void
+{
+  // Set with the lock held, which the callback releases last: once the flag
+  // is seen, the callback no longer touches the pool.
+  auto ready = std::make_shared<bool>(false);
+  future.checked_state()->on_ready(task_t([this, ready] {
+                                     auto l = lock();
+                                     *ready = true;
+                                     help_cv_.notify_all();
+                                   }),
+                                   false);
+  help_until([&ready] { return *ready; });
+}
+
+/// \exclude
+namespace detail
+{
+
+template <typename T> struct when_all_state {
+  auto done() -> void
+  {
+    if (remaining.fetch_sub(1, std::memory_order_acq_rel) != 1)
+      return;
+
+    for (const auto& input : inputs) {
+      if (input->error())
+        return output->set_exception(input->error());
+    }
+    finish(std::is_void<T>{});
+  }
+
+  auto finish(std::true_type) -> void { output->set_value(); }
+
+  auto finish(std::false_type) -> void
+  {
+    output->fulfil([this]() -> std::vector<T> {
+      auto values = std::vector<T>();
+      values.reserve(inputs.size());
+      for (const auto& input : inputs)
+        values.push_back(input->take());
+      return values;
+    });
+  }
+
+  std::vector<std::shared_ptr<future_state<T>>> inputs;
+  std::shared_ptr<future_state<typename when_all_result<T>::type>> output;
+  std::atomic<std::size_t> remaining{0};
+};
+
+} // namespace detail
+
+/// Returns a future ready once all `futures` are.
+///
+/// The result holds the values of the futures in order, or the exception of the first future
+/// that threw.
+template <typename T>
+auto when_all(std::vector<task_future<T>> futures) -> task_future<typename detail::when_all_result<T>::type>
+{
+  using result_t = typename detail::when_all_result<T>::type;
+
+  auto all = std::make_shared<detail::when_all_state<T>>();
+  for (auto& future : futures)
+    all->inputs.push_back(future.release());
+  all->output = std::make_shared<detail::future_state<result_t>>(all->inputs.empty() ? nullptr : all->inputs[0]->pool());
+  all->remaining.store(all->inputs.size() + 1, std::memory_order_relaxed);
+
+  const auto inputs = all->inputs;
+  for (const auto& input : inputs)
+    input->on_ready([all] { all->done(); }, false);
+
+  auto result = task_future<result_t>{all->output};
+  all->done();
+  return result;
+}
+
+/// Result of `when_any`: the index of the first ready future, and all the futures.
+template <typename T> struct when_any_result {
+  std::size_t index;
+  std::vector<task_future<T>> futures;
 };
 
+/// Returns a future ready once any of `futures` is.
+///
+/// If `futures` is empty, the result is ready right away, with an index of `std::size_t(-1)`.
+template <typename T> auto when_any(std::vector<task_future<T>> futures) -> task_future<when_any_result<T>>
+{
+  struct any_state {
+    std::vector<task_future<T>> futures;
+    std::shared_ptr<detail::future_state<when_any_result<T>>> output;
+    std::atomic<bool> done{false};
+  };
+
+  auto states = std::vector<std::shared_ptr<detail::future_state<T>>>();
+  for (auto& future : futures) {
+    future.checked_state();
+    states.push_back(future.state_);
+  }
+
+  auto any = std::make_shared<any_state>();
+  any->output = std::make_shared<detail::future_state<when_any_result<T>>>(states.empty() ? nullptr : states[0]->pool());
+  any->futures = std::move(futures);
+
+  auto result = task_future<when_any_result<T>>{any->output};
+  if (states.empty()) {
+    any->output->set_value(when_any_result<T>{static_cast<std::size_t>(-1), std::move(any->futures)});
+    return result;
+  }
+
+  for (auto i : indices(states.size())) {
+    states[i]->on_ready(
+      [any, i] {
+        if (!any->done.exchange(true))
+          any->output->set_value(when_any_result<T>{i, std::move(any->futures)});
+      },
+      false);
+  }
+  return result;
+}
+
 } // namespace cool
 
 #undef RESULT_OF_T
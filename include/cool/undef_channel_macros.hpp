@@ -0,0 +1,7 @@
+// Undefines the macros of channel_macros.hpp.
+
+#undef NODISCARD
+#undef COOL_TRY
+#undef COOL_CATCH_ALL
+#undef COOL_RETHROW
+#undef COOL_THROW
@@ -0,0 +1,157 @@
+// Strategies for threads waiting on a condition.
+
+#ifndef COOL_WAIT_STRATEGY_HXX_INCLUDED
+/// \exclude
+#define COOL_WAIT_STRATEGY_HXX_INCLUDED
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+namespace cool
+{
+
+/// \exclude
+namespace detail
+{
+
+inline auto cpu_relax() noexcept -> void
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  _mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+} // namespace detail
+
+/// How a blocked thread waits for the condition that unblocks it.
+///
+/// Parking a thread on a condition variable is cheap in CPU but costs a system call
+/// to sleep and another to wake up; spinning keeps the thread on its core and reacts
+/// faster, at the cost of burning CPU while waiting.
+///
+/// - `block` parks the thread right away.
+/// - `spin_then_block` polls the condition `spins` times with a CPU pause instruction,
+///   then parks the thread.
+/// - `yield` polls the condition, yielding the rest of the time slice between polls.
+/// - `busy_spin` polls the condition with a CPU pause instruction between polls.
+///
+/// \module Wait strategy
+///
+/// \notes `yield` and `busy_spin` never park the thread: they keep a core busy for as
+///        long as the thread waits.
+/// \notes With mutex-based waits, the mutex is released between polls.
+class wait_strategy
+{
+public:
+  /// \group strategies Wait strategies
+  static constexpr auto block() noexcept -> wait_strategy { return wait_strategy{kind::block, 0}; }
+
+  /// \group strategies
+  static constexpr auto spin_then_block(unsigned spins = 128) noexcept -> wait_strategy
+  {
+    return wait_strategy{kind::spin_then_block, spins};
+  }
+
+  /// \group strategies
+  static constexpr auto yield() noexcept -> wait_strategy { return wait_strategy{kind::yield, 0}; }
+
+  /// \group strategies
+  static constexpr auto busy_spin() noexcept -> wait_strategy { return wait_strategy{kind::busy_spin, 0}; }
+
+  /// Queries whether waiting threads are eventually parked.
+  constexpr auto parks() const noexcept -> bool { return kind_ == kind::block || kind_ == kind::spin_then_block; }
+
+  /// \exclude
+  template <typename P> auto spin(P& ready) const -> bool
+  {
+    for (auto i = 0u; !parks() || i < spins_; ++i) {
+      if (ready())
+        return true;
+      pause();
+    }
+    return ready();
+  }
+
+  /// \exclude
+  template <typename Clock, typename Duration, typename P>
+  auto spin_until(const std::chrono::time_point<Clock, Duration>& time, P& ready) const -> bool
+  {
+    for (auto i = 0u; !parks() || i < spins_; ++i) {
+      if (ready())
+        return true;
+      if (!parks() && Clock::now() >= time)
+        return false;
+      pause();
+    }
+    return ready();
+  }
+
+  /// \exclude
+  template <typename P> auto wait(std::condition_variable& cv, std::unique_lock<std::mutex>& l, P ready) const -> void
+  {
+    for (auto i = 0u; !parks() || i < spins_; ++i) {
+      if (ready())
+        return;
+      l.unlock();
+      pause();
+      l.lock();
+    }
+    cv.wait(l, ready);
+  }
+
+  /// \exclude
+  template <typename Clock, typename Duration, typename P>
+  auto wait_until(std::condition_variable& cv, std::unique_lock<std::mutex>& l,
+                  const std::chrono::time_point<Clock, Duration>& time, P ready) const -> bool
+  {
+    for (auto i = 0u; !parks() || i < spins_; ++i) {
+      if (ready())
+        return true;
+      if (!parks() && Clock::now() >= time)
+        return false;
+      l.unlock();
+      pause();
+      l.lock();
+    }
+    return cv.wait_until(l, time, ready);
+  }
+
+  /// \group comparison Checks whether or not two strategies are the same.
+  constexpr auto operator==(const wait_strategy& other) const noexcept -> bool
+  {
+    return kind_ == other.kind_ && spins_ == other.spins_;
+  }
+
+  /// \group comparison
+  constexpr auto operator!=(const wait_strategy& other) const noexcept -> bool { return !(*this == other); }
+
+private:
+  enum class kind { block, spin_then_block, yield, busy_spin };
+
+  constexpr wait_strategy(kind k, unsigned spins) noexcept : kind_{k}, spins_{spins} {}
+
+  auto pause() const noexcept -> void
+  {
+    if (kind_ == kind::yield)
+      std::this_thread::yield();
+    else
+      detail::cpu_relax();
+  }
+
+  kind kind_;
+  unsigned spins_;
+};
+
+} // namespace cool
+
+#endif // COOL_WAIT_STRATEGY_HXX_INCLUDED
@@ -0,0 +1,222 @@
+// Placement of thread pool workers on CPUs.
+
+#ifndef COOL_WORKER_PLACEMENT_HPP_INCLUDED
+/// \exclude
+#define COOL_WORKER_PLACEMENT_HPP_INCLUDED
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace cool
+{
+
+/// \exclude
+namespace detail
+{
+
+// Parses a CPU list as found in sysfs, such as "0-3,8,10-11".
+inline auto parse_cpu_list(const std::string& list) -> std::vector<unsigned>
+{
+  auto cpus = std::vector<unsigned>();
+  auto i = std::size_t{0};
+
+  const auto number = [&list, &i](unsigned& value) {
+    const auto start = i;
+    value = 0;
+    for (; i < list.size() && list[i] >= '0' && list[i] <= '9'; ++i)
+      value = value * 10 + static_cast<unsigned>(list[i] - '0');
+    return i != start;
+  };
+
+  while (i < list.size()) {
+    auto first = 0u;
+    if (!number(first))
+      break;
+
+    auto last = first;
+    if (i < list.size() && list[i] == '-') {
+      ++i;
+      if (!number(last))
+        break;
+    }
+
+    for (auto cpu = first; cpu <= last; ++cpu)
+      cpus.push_back(cpu);
+
+    if (i < list.size() && list[i] == ',')
+      ++i;
+    else
+      break;
+  }
+  return cpus;
+}
+
+// CPUs the calling thread may run on.
+inline auto allowed_cpus() -> std::vector<unsigned>
+{
+  auto cpus = std::vector<unsigned>();
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (auto cpu = 0u; cpu < CPU_SETSIZE; ++cpu)
+      if (CPU_ISSET(cpu, &set))
+        cpus.push_back(cpu);
+  }
+#endif
+  if (cpus.empty()) {
+    for (auto cpu = 0u; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu)
+      cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+// Allowed CPUs of each NUMA node, from sysfs.  Nodes without allowed CPUs are
+// skipped; without NUMA information, all allowed CPUs form a single node.
+inline auto numa_nodes(const std::vector<unsigned>& allowed) -> std::vector<std::vector<unsigned>>
+{
+  auto nodes = std::vector<std::vector<unsigned>>();
+  auto online = std::string();
+  if (std::getline(std::ifstream{"/sys/devices/system/node/online"}, online)) {
+    for (auto node : parse_cpu_list(online)) {
+      auto list = std::string();
+      if (!std::getline(std::ifstream{"/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"}, list))
+        continue;
+
+      auto cpus = std::vector<unsigned>();
+      for (auto cpu : parse_cpu_list(list))
+        for (auto a : allowed)
+          if (a == cpu)
+            cpus.push_back(cpu);
+
+      if (!cpus.empty())
+        nodes.push_back(std::move(cpus));
+    }
+  }
+
+  if (nodes.empty())
+    nodes.push_back(allowed);
+  return nodes;
+}
+
+} // namespace detail
+
+/// Where the workers of a thread pool run.
+///
+/// A placement is made of groups of CPUs.  Workers are spread over the groups in turn,
+/// then over the CPUs within each group, and each worker is pinned to the CPUs of its
+/// group, or to a single CPU.  Tasks can be enqueued on a given group with
+/// `thread_pool::enqueue_on`.
+///
+/// - `anywhere` doesn't pin workers.
+/// - `cores` pins one worker to each CPU the process may run on, in a single group.
+/// - `numa_nodes` makes a group of each NUMA node, and pins workers to the CPUs of
+///   their node.
+/// - `cpu_sets` makes a group of each given set of CPUs.
+///
+/// \module Thread pool
+///
+/// \notes Pinning is only supported on Linux.  Elsewhere, and if pinning fails,
+///        workers run unpinned but groups still apply to `thread_pool::enqueue_on`.
+class worker_placement
+{
+public:
+  /// \group placements Worker placements
+  static auto anywhere() -> worker_placement { return worker_placement{{}, false}; }
+
+  /// \group placements
+  static auto cores() -> worker_placement { return worker_placement{{detail::allowed_cpus()}, true}; }
+
+  /// \group placements
+  static auto numa_nodes() -> worker_placement { return worker_placement{detail::numa_nodes(detail::allowed_cpus()), false}; }
+
+  /// \group placements
+  ///
+  /// \notes Throws `std::invalid_argument` if a set is empty.
+  static auto cpu_sets(std::vector<std::vector<unsigned>> sets) -> worker_placement
+  {
+    for (const auto& set : sets)
+      if (set.empty())
+        throw std::invalid_argument{"empty CPU set"};
+    return worker_placement{std::move(sets), false};
+  }
+
+  /// Returns the number of groups, zero for `anywhere`.
+  auto groups() const noexcept -> std::size_t { return groups_.size(); }
+
+  /// Returns the number of CPUs of all groups, zero for `anywhere`.
+  auto cpus() const noexcept -> std::size_t
+  {
+    auto count = std::size_t{0};
+    for (const auto& group : groups_)
+      count += group.size();
+    return count;
+  }
+
+  /// \exclude
+  struct slot {
+    std::size_t group;
+    std::vector<unsigned> cpus;
+  };
+
+  /// \exclude
+  ///
+  /// Returns the group of the `worker`-th worker and the CPUs to pin it to.  Workers go
+  /// round the groups, taking the next CPU of each, so that the first workers are spread
+  /// over all groups.
+  auto slot_of(std::size_t worker) const -> slot
+  {
+    if (groups_.empty())
+      return slot{0, {}};
+
+    auto index = worker % cpus();
+    for (auto cpu = std::size_t{0};; ++cpu) {
+      for (auto group = std::size_t{0}; group < groups_.size(); ++group) {
+        if (cpu >= groups_[group].size())
+          continue;
+        if (index == 0)
+          return slot{group, per_cpu_ ? std::vector<unsigned>{groups_[group][cpu]} : groups_[group]};
+        --index;
+      }
+    }
+  }
+
+  /// \exclude
+  ///
+  /// Pins the calling thread to `cpus`, does nothing if `cpus` is empty.
+  static auto pin(const std::vector<unsigned>& cpus) -> bool
+  {
+    if (cpus.empty())
+      return true;
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu : cpus)
+      if (cpu < CPU_SETSIZE)
+        CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+  }
+
+private:
+  worker_placement(std::vector<std::vector<unsigned>> groups, bool per_cpu) : groups_{std::move(groups)}, per_cpu_{per_cpu} {}
+
+  std::vector<std::vector<unsigned>> groups_;
+  bool per_cpu_;
+};
+
+} // namespace cool
+
+#endif // COOL_WORKER_PLACEMENT_HPP_INCLUDED
@@ -0,0 +1,145 @@
+#include <cool/broadcast.hpp>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace cool;
+
+TEST_CASE("Broadcast channel", "[broadcast]")
+{
+  SECTION("every subscriber receives every message")
+  {
+    auto ch = broadcast<std::string>{4u};
+    auto a = ch.subscribe();
+    auto b = ch.subscribe();
+    CHECK(ch.subscribers() == 2u);
+
+    ch.publish("x");
+    ch.publish(std::string{"y"});
+    ch.close();
+
+    CHECK(a.receive() == "x");
+    CHECK(a.receive() == "y");
+    CHECK_THROWS_AS(a.receive(), empty_closed_channel);
+
+    auto s = std::string{};
+    CHECK(b.receive(s) == channel_status::ok);
+    CHECK(s == "x");
+    b.receive_with([](const std::string& v) { CHECK(v == "y"); });
+    CHECK(b.receive(s) == channel_status::closed);
+
+    CHECK_THROWS_AS(ch.publish("z"), closed_channel);
+    CHECK(ch.publish("z", std::nothrow) == channel_status::closed);
+  }
+
+  SECTION("subscribers only receive later messages")
+  {
+    auto ch = broadcast<int>{4u};
+    ch.publish(1);
+
+    auto sub = ch.subscribe();
+    auto v = 0;
+    CHECK(sub.try_receive(v) == channel_status::timeout);
+    CHECK(sub.receive_for(v, std::chrono::milliseconds{1}) == channel_status::timeout);
+
+    ch.publish(2);
+    CHECK(sub.try_receive(v) == channel_status::ok);
+    CHECK(v == 2);
+  }
+
+  SECTION("block policy waits for the slowest subscriber")
+  {
+    auto ch = broadcast<int>{2u};
+    CHECK(ch.capacity() == 2u);
+    auto fast = ch.subscribe();
+    auto slow = ch.subscribe();
+
+    ch.publish(1);
+    ch.publish(2);
+    CHECK(ch.try_publish(3, std::nothrow) == channel_status::timeout);
+
+    CHECK(fast.receive() == 1);
+    CHECK(ch.try_publish(3, std::nothrow) == channel_status::timeout);
+
+    CHECK(slow.receive() == 1);
+    CHECK(ch.try_publish(3, std::nothrow) == channel_status::ok);
+
+    slow.unsubscribe();
+    CHECK_FALSE(slow.is_connected());
+    CHECK(ch.subscribers() == 1u);
+
+    CHECK(fast.receive() == 2);
+    CHECK(ch.try_publish(4, std::nothrow) == channel_status::ok);
+
+    CHECK_FALSE(ch.try_publish(5));
+    CHECK(fast.receive() == 3);
+    CHECK(ch.try_publish(5));
+
+    ch.close();
+    CHECK_THROWS_AS(ch.try_publish(6), closed_channel);
+  }
+
+  SECTION("drop oldest policy skips overwritten messages")
+  {
+    auto ch = broadcast<int>{2u, broadcast_policy::drop_oldest};
+    auto sub = ch.subscribe();
+
+    for (int i = 0; i < 5; ++i)
+      ch.publish(i);
+
+    CHECK(sub.receive() == 3);
+    CHECK(sub.dropped() == 3u);
+    CHECK(sub.receive() == 4);
+    CHECK(sub.is_connected());
+  }
+
+  SECTION("disconnect policy disconnects slow subscribers")
+  {
+    auto ch = broadcast<int>{2u, broadcast_policy::disconnect};
+    auto slow = ch.subscribe();
+    auto fast = ch.subscribe();
+
+    for (int i = 0; i < 3; ++i) {
+      ch.publish(i);
+      CHECK(fast.receive() == i);
+    }
+
+    auto v = 0;
+    CHECK(slow.receive(v) == channel_status::closed);
+    CHECK_FALSE(slow.is_connected());
+    CHECK(ch.subscribers() == 1u);
+    CHECK(fast.is_connected());
+  }
+
+  SECTION("concurrent subscribers")
+  {
+    constexpr int count = 10000;
+    auto ch = broadcast<int>{16u};
+
+    auto subs = std::vector<subscription<int>>{};
+    for (int i = 0; i < 4; ++i)
+      subs.push_back(ch.subscribe());
+
+    auto sums = std::vector<long>(subs.size());
+    auto threads = std::vector<std::thread>{};
+    for (std::size_t i = 0; i < subs.size(); ++i)
+      threads.emplace_back([&subs, &sums, i] {
+        auto v = 0;
+        while (subs[i].receive(v) == channel_status::ok)
+          sums[i] += v;
+      });
+
+    for (int i = 0; i < count; ++i)
+      ch.publish(i);
+    ch.close();
+
+    for (auto& t : threads)
+      t.join();
+
+    for (const auto sum : sums)
+      CHECK(sum == long{count} * (count - 1) / 2);
+  }
+}
@@ -1,6 +1,9 @@
 #include <cool/channel.hpp>
 
 #include <future>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <catch2/catch_test_macros.hpp>
 
@@ -247,3 +250,809 @@ TEST_CASE("Channel exception safety", "[channel]")
     CHECK(ch.receive() == 3);
   }
 }
+
+TEST_CASE("Single-producer/single-consumer channel", "[channel]")
+{
+  // The backend is chosen by the second template parameter.
+  // SPSC channels are bounded and allow one sender and one receiver at a time.
+  {
+    auto ch = channel<int, spsc_backend>(3u);
+    CHECK(ch.buffer_size() == 3u);
+    CHECK_FALSE(ch.is_closed());
+
+    ch.send(1);
+    ch << 2 << 3;
+    CHECK(ch.receive() == 1);
+
+    int x = 0;
+    CHECK(ch >> x);
+    CHECK(x == 2);
+
+    ch.close();
+    CHECK(ch.is_closed());
+    CHECK_THROWS_AS(ch.send(4), closed_channel);
+
+    // Buffered data is still available after closing.
+    CHECK(ch.receive() == 3);
+    CHECK_THROWS_AS(ch.receive(), empty_closed_channel);
+    CHECK_FALSE(ch >> x);
+  }
+
+  {
+    auto ch = channel<int, spsc_backend>(1u);
+    CHECK(ch.wait_for(std::chrono::milliseconds{1}, [](int) { CHECK(false); }) == std::cv_status::timeout);
+    ch << 1;
+    CHECK(ch.wait_for(std::chrono::milliseconds{1}, [](int i) { CHECK(i == 1); }) == std::cv_status::no_timeout);
+    ch.close();
+    CHECK_THROWS_AS(ch.wait_for(std::chrono::milliseconds{1}, [](int) {}), empty_closed_channel);
+  }
+
+  // Buffered elements are destroyed with the channel.
+  {
+    auto p = std::make_shared<int>(0);
+    {
+      auto ch = channel<std::shared_ptr<int>, spsc_backend>(4u);
+      ch << p << p;
+      CHECK(p.use_count() == 3);
+    }
+    CHECK(p.use_count() == 1);
+  }
+
+  // Blocking transfer between two threads through a small ring.
+  {
+    auto ch = channel<long, spsc_backend>(4u);
+    const long n = 10000;
+
+    const auto sum = [](ichannel<long, spsc_backend> ch) {
+      long x = 0, s = 0;
+      while (ch >> x)
+        s += x;
+      return s;
+    };
+
+    auto total = std::async(std::launch::async, sum, ch);
+    for (long i = 1; i <= n; ++i)
+      ch << i;
+    ch.close();
+
+    CHECK(total.get() == n * (n + 1) / 2);
+  }
+}
+
+TEST_CASE("Multi-producer/multi-consumer channel", "[channel]")
+{
+  // MPMC channels are bounded and allow any number of senders and receivers.
+  // The buffer size is rounded up to a power of two.
+  {
+    auto ch = channel<int, mpmc_backend>(3u);
+    CHECK(ch.buffer_size() == 4u);
+    CHECK(channel<int, mpmc_backend>(1u).buffer_size() == 2u);
+
+    ochannel<int, mpmc_backend> och = ch;
+    ichannel<int, mpmc_backend> ich = ch;
+    CHECK(och == ich);
+
+    och << 1 << 2 << eod;
+    CHECK(ich.is_closed());
+    CHECK_THROWS_AS(och.send(3), closed_channel);
+
+    int x = 0;
+    CHECK(ich >> x);
+    CHECK(x == 1);
+    CHECK(ich.receive() == 2);
+    CHECK_FALSE(ich >> x);
+    CHECK_THROWS_AS(ich.wait_for(std::chrono::milliseconds{1}, [](int) {}), empty_closed_channel);
+  }
+
+  // Blocking transfer among several threads through a small ring.
+  {
+    auto ch = channel<long, mpmc_backend>(8u);
+    const long n = 4000;
+    const int producers = 3, consumers = 3;
+
+    const auto sum = [](ichannel<long, mpmc_backend> ch) {
+      long x = 0, s = 0;
+      while (ch >> x)
+        s += x;
+      return s;
+    };
+
+    const auto write = [n](ochannel<long, mpmc_backend> ch) {
+      for (long i = 1; i <= n; ++i)
+        ch << i;
+    };
+
+    std::vector<std::future<long>> totals;
+    for (int i = 0; i < consumers; ++i)
+      totals.push_back(std::async(std::launch::async, sum, ch));
+
+    {
+      std::vector<std::future<void>> writers;
+      for (int i = 0; i < producers; ++i)
+        writers.push_back(std::async(std::launch::async, write, ch));
+    }
+    ch.close();
+
+    long total = 0;
+    for (auto& t : totals)
+      total += t.get();
+
+    CHECK(total == producers * n * (n + 1) / 2);
+  }
+
+  // Values whose copy may throw are built before a slot is claimed.
+  {
+    auto ch = channel<std::string, mpmc_backend>(2u);
+    const auto s = std::string(100, 'x');
+    ch.send(s);
+    CHECK(ch.receive() == s);
+  }
+}
+
+TEST_CASE("Channel batch operations", "[channel]")
+{
+  // Several elements can be sent and received at once.
+  {
+    auto ch = channel<int>();
+    const auto values = std::vector<int>{1, 2, 3, 4, 5};
+
+    ch.send_range(values.begin(), values.end());
+    ch.send_n(values.begin(), 2u);
+
+    int out[4] = {};
+    auto last = ch.receive_into(out, 4u);
+    CHECK(last == out + 4);
+    CHECK(out[0] == 1);
+    CHECK(out[3] == 4);
+
+    // `drain` takes everything that is available.
+    auto rest = std::vector<int>{0};
+    CHECK(ch.drain(rest) == 3u);
+    CHECK(rest == (std::vector<int>{0, 5, 1, 2}));
+
+    ch.close();
+    CHECK_THROWS_AS(ch.send_range(values.begin(), values.end()), closed_channel);
+    CHECK_THROWS_AS(ch.drain(rest), empty_closed_channel);
+  }
+
+  // When the buffer is full, what fits is sent and the caller blocks for the rest.
+  {
+    auto ch = channel<int, mpmc_backend>(8u);
+    const auto n = 1000;
+    auto values = std::vector<int>(n);
+    for (int i = 0; i < n; ++i)
+      values[i] = i + 1;
+
+    auto sent = std::async(std::launch::async, [ch, &values]() mutable {
+      ch.send_range(values.begin(), values.end());
+      ch.close();
+    });
+
+    auto received = std::vector<int>();
+    try {
+      while (true)
+        ch.drain(received);
+    } catch (const empty_closed_channel&) {
+    }
+    sent.get();
+
+    CHECK(received == values);
+  }
+
+  {
+    auto ch = channel<int, spsc_backend>(8u);
+    auto sent = std::async(std::launch::async, [ch]() mutable {
+      const auto values = std::vector<int>(100, 1);
+      ch.send_range(values.begin(), values.end());
+      ch.close();
+    });
+
+    auto total = 0;
+    int buffer[16];
+    try {
+      while (true) {
+        const auto last = ch.receive_into(buffer, 16u);
+        for (auto it = buffer; it != last; ++it)
+          total += *it;
+      }
+    } catch (const empty_closed_channel&) {
+    }
+    sent.get();
+
+    CHECK(total == 100);
+  }
+
+  {
+    auto ch = channel<int>(3u);
+    auto sent = std::async(std::launch::async, [ch]() mutable {
+      const auto values = std::vector<int>(100, 1);
+      ch.send_n(values.begin(), values.size());
+      ch.close();
+    });
+
+    auto received = std::vector<int>();
+    try {
+      while (true)
+        ch.drain(received);
+    } catch (const empty_closed_channel&) {
+    }
+    sent.get();
+
+    CHECK(received.size() == 100u);
+  }
+
+  // Batches of values whose copy may throw go through the element-wise path.
+  {
+    auto ch = channel<std::string, mpmc_backend>(2u);
+    const auto values = std::vector<std::string>{"a", "b"};
+    ch.send_range(values.begin(), values.end());
+    auto received = std::vector<std::string>();
+    CHECK(ch.drain(received) == 2u);
+    CHECK(received == values);
+  }
+}
+
+TEST_CASE("Non-blocking and timed channel operations", "[channel]")
+{
+  // `try_send` and `try_receive` never block.
+  {
+    auto ch = channel<int>(1u);
+
+    CHECK_FALSE(ch.try_receive());
+
+    CHECK(ch.try_send(1));
+    CHECK_FALSE(ch.try_send(2));
+
+    auto value = ch.try_receive();
+    REQUIRE(value);
+    CHECK(*value == 1);
+    CHECK_FALSE(ch.try_receive().has_value());
+
+    ch.close();
+    CHECK_THROWS_AS(ch.try_send(3), closed_channel);
+    CHECK_THROWS_AS(ch.try_receive(), empty_closed_channel);
+  }
+
+  // Unsent values are left untouched.
+  {
+    auto ch = channel<std::string, spsc_backend>(1u);
+    auto s = std::string(100, 'x');
+
+    CHECK(ch.try_send(std::move(s)));
+    s = std::string(100, 'y');
+    CHECK_FALSE(ch.try_send(std::move(s)));
+    CHECK(s == std::string(100, 'y'));
+
+    CHECK(ch.send_for(std::move(s), std::chrono::milliseconds{1}) == std::cv_status::timeout);
+    CHECK(s == std::string(100, 'y'));
+
+    CHECK(*ch.try_receive() == std::string(100, 'x'));
+    CHECK(ch.send_until(std::move(s), std::chrono::steady_clock::now()) == std::cv_status::no_timeout);
+    CHECK(*ch.try_receive() == std::string(100, 'y'));
+  }
+
+  // A timed send succeeds as soon as room is made.
+  {
+    auto ch = channel<int, mpmc_backend>(2u);
+    ochannel<int, mpmc_backend> och = ch;
+    ichannel<int, mpmc_backend> ich = ch;
+
+    CHECK(och.try_send(1));
+    CHECK(och.try_send(2));
+    CHECK_FALSE(och.try_send(3));
+    CHECK(och.send_for(3, std::chrono::milliseconds{1}) == std::cv_status::timeout);
+
+    auto receiver = std::async(std::launch::async, [ich]() mutable { return ich.receive(); });
+    CHECK(och.send_for(3, std::chrono::seconds{10}) == std::cv_status::no_timeout);
+    CHECK(receiver.get() == 1);
+    CHECK(*ich.try_receive() == 2);
+    CHECK(*ich.try_receive() == 3);
+
+    och << eod;
+    CHECK_THROWS_AS(och.send_for(3, std::chrono::milliseconds{1}), closed_channel);
+    CHECK_THROWS_AS(ich.try_receive(), empty_closed_channel);
+  }
+
+  // Results can be copied and moved like an optional.
+  {
+    auto ch = channel<std::string>();
+    ch.send("abc");
+
+    auto a = ch.try_receive();
+    auto b = a;
+    auto c = std::move(a);
+    CHECK(*b == "abc");
+    CHECK(c->size() == 3u);
+
+    b = ch.try_receive();
+    CHECK_FALSE(b);
+  }
+}
+
+TEST_CASE("Selecting among channel operations", "[channel]")
+{
+  // `select` performs whichever registered operation can proceed first.
+  {
+    auto ich = channel<int>();
+    auto sch = channel<std::string, mpmc_backend>(4u);
+    auto och = channel<long, spsc_backend>(1u);
+
+    int i = 0;
+    std::string s;
+    bool sent = false;
+
+    auto sel = cool::select{};
+    sel.receive(ich, [&i](int x) { i = x; })
+      .receive(ichannel<std::string, mpmc_backend>{sch}, [&s](std::string x) { s = std::move(x); })
+      .send(ochannel<long, spsc_backend>{och}, 7, [&sent] { sent = true; });
+
+    // Only the send can proceed.
+    CHECK(sel.wait() == 2u);
+    CHECK(sent);
+    CHECK(och.receive() == 7);
+
+    // Now the output is full.
+    och << 1;
+    sch << "hello";
+    CHECK(sel.wait() == 1u);
+    CHECK(s == "hello");
+
+    // Blocks until another thread provides data.
+    auto writer = std::async(std::launch::async, [ich]() mutable {
+      std::this_thread::sleep_for(std::chrono::milliseconds{10});
+      ich << 42;
+    });
+    CHECK(sel.wait() == 0u);
+    CHECK(i == 42);
+    writer.get();
+  }
+
+  // A default case runs when nothing is ready, and a timeout case when nothing gets ready in time.
+  {
+    auto ch = channel<int, spsc_backend>(1u);
+    bool idle = false, expired = false;
+
+    auto nonblocking = cool::select{};
+    nonblocking.receive(ch, [](int) { CHECK(false); }).otherwise([&idle] { idle = true; });
+    CHECK(nonblocking.wait() == 1u);
+    CHECK(idle);
+
+    auto timed = cool::select{};
+    timed.after(std::chrono::milliseconds{5}, [&expired] { expired = true; }).receive(ch, [](int x) { CHECK(x == 3); });
+    CHECK(timed.wait() == 0u);
+    CHECK(expired);
+
+    ch << 3;
+    CHECK(timed.wait() == 1u);
+  }
+
+  // Closed and empty channels never become ready.
+  {
+    auto a = channel<int>();
+    auto b = channel<int, mpmc_backend>(2u);
+    int total = 0;
+
+    auto sel = cool::select{};
+    sel.receive(a, [&total](int x) { total += x; }).receive(b, [&total](int x) { total += x; });
+
+    auto writer = std::async(std::launch::async, [a, b]() mutable {
+      a << 1 << 2 << eod;
+      b << 3 << 4 << eod;
+    });
+
+    try {
+      while (true)
+        sel.wait();
+    } catch (const empty_closed_channel&) {
+    }
+    writer.get();
+    CHECK(total == 10);
+
+    auto closed = channel<int>();
+    closed.close();
+    auto send_sel = cool::select{};
+    send_sel.send(closed, 1, [] {});
+    CHECK_THROWS_AS(send_sel.wait(), closed_channel);
+  }
+}
+
+TEST_CASE("Channel with many blocked senders and receivers", "[channel]")
+{
+  // Senders and receivers wait on separate queues, so a transfer always wakes the other side.
+  auto ch = channel<long>(2u);
+  const long n = 500;
+  const int threads = 16;
+
+  std::vector<std::future<long>> totals;
+  for (int i = 0; i < threads; ++i)
+    totals.push_back(std::async(std::launch::async, [ch]() mutable {
+      long x = 0, s = 0;
+      while (ch >> x)
+        s += x;
+      return s;
+    }));
+
+  {
+    std::vector<std::future<void>> writers;
+    for (int i = 0; i < threads; ++i)
+      writers.push_back(std::async(std::launch::async, [ch, n]() mutable {
+        for (long j = 1; j <= n; ++j)
+          ch << j;
+      }));
+  }
+
+  // Growing the buffer and closing wake everyone that can proceed.
+  ch.buffer_size(8u);
+  ch.close();
+
+  long total = 0;
+  for (auto& t : totals)
+    total += t.get();
+
+  CHECK(total == threads * n * (n + 1) / 2);
+}
+
+TEST_CASE("Channel buffer growth", "[channel]")
+{
+  // Unbounded channels grow their buffer as needed and keep the order.
+  {
+    auto ch = channel<std::string>();
+    for (int round = 0; round < 3; ++round) {
+      for (int i = 0; i < 100; ++i)
+        ch << std::to_string(i);
+      for (int i = 0; i < 100; ++i)
+        CHECK(ch.receive() == std::to_string(i));
+    }
+  }
+
+  // Growing the buffer keeps the elements that wrapped around the ring.
+  {
+    auto ch = channel<int>(4u);
+    ch << 0 << 1 << 2;
+    CHECK(ch.receive() == 0);
+    CHECK(ch.receive() == 1);
+    ch << 3 << 4 << 5;
+
+    ch.buffer_size(64u);
+    for (int i = 6; i < 40; ++i)
+      ch << i;
+
+    for (int i = 2; i < 40; ++i)
+      CHECK(ch.receive() == i);
+  }
+
+  // Buffered elements are destroyed with the channel.
+  {
+    auto p = std::make_shared<int>(0);
+    {
+      auto ch = channel<std::shared_ptr<int>>();
+      for (int i = 0; i < 20; ++i)
+        ch << p;
+      CHECK(ch.receive() == p);
+      CHECK(p.use_count() == 20);
+    }
+    CHECK(p.use_count() == 1);
+  }
+}
+
+namespace {
+struct payload {
+  explicit payload(int id) noexcept : id{id} {}
+  payload(int id, std::size_t size) : id{id}, data(size, 'x') {}
+
+  payload(const payload&) = delete;
+  payload(payload&& other) noexcept : id{other.id}, data{std::move(other.data)} { ++moves; }
+
+  auto operator=(const payload&) -> payload& = delete;
+  auto operator=(payload&&) -> payload& = delete;
+
+  int id;
+  std::string data;
+  static int moves;
+};
+
+int payload::moves = 0;
+
+struct first_level {
+  auto operator()(const payload&) const -> int { return 0; }
+};
+} // namespace
+
+TEST_CASE("In-place channel transfers", "[channel]")
+{
+  // Values are built in the buffer and inspected there: nothing is relocated.
+  const auto check = [](ochannel<payload, spsc_backend> och, ichannel<payload, spsc_backend> ich) {
+    payload::moves = 0;
+
+    och.emplace_send(1, 1000u);
+    och.emplace_send(2, 10u);
+
+    int id = 0;
+    ich.receive_with([&id](payload& p) {
+      id = p.id;
+      CHECK(p.data.size() == 1000u);
+    });
+    CHECK(id == 1);
+
+    ich.receive_with([&id](const payload& p) { id = p.id; });
+    CHECK(id == 2);
+    CHECK(payload::moves == 0);
+
+    och.close();
+    CHECK_THROWS_AS(och.emplace_send(3, 1u), closed_channel);
+    CHECK_THROWS_AS(ich.receive_with([](payload&) {}), empty_closed_channel);
+  };
+
+  auto spsc = channel<payload, spsc_backend>(2u);
+  check(spsc, spsc);
+
+  // A buffer of fixed size never relocates its values.
+  payload::moves = 0;
+  auto ch = channel<payload>(2u);
+  ch.emplace_send(1, 1u);
+  ch.emplace_send(2, 1u);
+  ch.receive_with([](payload& p) { CHECK(p.id == 1); });
+  ch.receive_with([](payload& p) { CHECK(p.id == 2); });
+  CHECK(payload::moves == 0);
+
+  // An unbounded buffer moves its values when it grows.
+  auto unbounded = channel<payload>{};
+  for (int i = 0; i < 100; ++i)
+    unbounded.emplace_send(i);
+  CHECK(payload::moves > 0);
+  for (int i = 0; i < 100; ++i)
+    unbounded.receive_with([i](payload& p) { CHECK(p.id == i); });
+
+  // The MPMC ring builds values in place only if that cannot throw.
+  payload::moves = 0;
+  auto mpmc = channel<payload, mpmc_backend>(2u);
+  mpmc.emplace_send(1);
+  mpmc.receive_with([](payload& p) { CHECK(p.id == 1); });
+  CHECK(payload::moves == 0);
+
+  mpmc.emplace_send(2, 1u);
+  mpmc.receive_with([](payload& p) { CHECK(p.id == 2); });
+  CHECK(payload::moves == 1);
+
+  // A bounded bucket channel moves each value into its level once, without growing it.
+  payload::moves = 0;
+  auto buckets = channel<payload, bucket_backend<2, first_level>>(64u);
+  for (int i = 0; i < 64; ++i)
+    buckets.emplace_send(i);
+  CHECK(payload::moves == 64);
+  for (int i = 0; i < 64; ++i)
+    buckets.receive_with([i](payload& p) { CHECK(p.id == i); });
+}
+
+TEST_CASE("Iterating over a channel", "[channel]")
+{
+  SECTION("range-for drains until closed")
+  {
+    auto ch = channel<int>{};
+    auto och = ochannel<int>{ch};
+    auto producer = std::thread{[och]() mutable {
+      for (int i = 0; i < 100; ++i)
+        och.send(i);
+      och.close();
+    }};
+
+    auto ich = ichannel<int>{ch};
+    auto expected = 0;
+    for (auto&& v : ich)
+      CHECK(v == expected++);
+    CHECK(expected == 100);
+
+    producer.join();
+  }
+
+  SECTION("closed empty channel yields nothing")
+  {
+    auto ch = channel<std::string, spsc_backend>(4u);
+    ch.close();
+    CHECK(ch.begin() == ch.end());
+  }
+
+  SECTION("standard algorithms")
+  {
+    auto ch = channel<std::string, mpmc_backend>(8u);
+    ch.send("a");
+    ch.send("b");
+    ch.send("c");
+    ch.close();
+
+    const auto v = std::vector<std::string>(ch.begin(), ch.end());
+    CHECK(v == (std::vector<std::string>{"a", "b", "c"}));
+  }
+
+  SECTION("stream operator does not throw at end of data")
+  {
+    auto ch = channel<int>{};
+    ch.send(1);
+    ch.close();
+
+    auto v = 0;
+    CHECK(ch >> v);
+    CHECK(v == 1);
+    CHECK_FALSE(ch >> v);
+  }
+}
+
+TEST_CASE("Channel status operations", "[channel]")
+{
+  auto ch = channel<int>(1u);
+  auto v = 0;
+
+  CHECK(ch.try_receive(v) == channel_status::timeout);
+  CHECK(ch.receive_for(v, std::chrono::milliseconds{1}) == channel_status::timeout);
+
+  CHECK(ch.send(1, std::nothrow) == channel_status::ok);
+  CHECK(ch.try_send(2, std::nothrow) == channel_status::timeout);
+  CHECK(ch.send_for(2, std::chrono::milliseconds{1}, std::nothrow) == channel_status::timeout);
+
+  CHECK(ch.receive(v) == channel_status::ok);
+  CHECK(v == 1);
+
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{1};
+  CHECK(ch.send_until(2, deadline, std::nothrow) == channel_status::ok);
+  ch.close();
+
+  CHECK(ch.send(3, std::nothrow) == channel_status::closed);
+  CHECK(ch.try_send(3, std::nothrow) == channel_status::closed);
+
+  auto ich = ichannel<int>{ch};
+  CHECK(ich.receive_until(v, deadline) == channel_status::ok);
+  CHECK(v == 2);
+  CHECK(ich.receive(v) == channel_status::closed);
+  CHECK(ich.try_receive(v) == channel_status::closed);
+  CHECK(ich.receive_for(v, std::chrono::milliseconds{1}) == channel_status::closed);
+  CHECK(v == 2);
+}
+
+namespace {
+struct message {
+  int priority;
+  int id;
+};
+
+struct by_priority {
+  auto operator()(const message& a, const message& b) const -> bool { return a.priority < b.priority; }
+};
+
+struct level_of {
+  auto operator()(const message& m) const -> std::size_t { return static_cast<std::size_t>(m.priority); }
+};
+} // namespace
+
+TEST_CASE("Priority channels", "[channel]")
+{
+  SECTION("heap ordered")
+  {
+    auto ch = channel<int, priority_backend<>>{};
+    for (const auto v : {3, 1, 4, 1, 5, 9, 2, 6})
+      ch.send(v);
+    ch.close();
+
+    const auto v = std::vector<int>(ch.begin(), ch.end());
+    CHECK(v == (std::vector<int>{9, 6, 5, 4, 3, 2, 1, 1}));
+  }
+
+  SECTION("equal priorities keep their order")
+  {
+    auto ch = channel<message, priority_backend<by_priority>>{};
+    ch.send(message{0, 1});
+    ch.send(message{1, 2});
+    ch.send(message{0, 3});
+    ch.send(message{1, 4});
+    ch.send(message{0, 5});
+
+    auto ids = std::vector<int>{};
+    for (int i = 0; i < 5; ++i)
+      ids.push_back(ch.receive().id);
+    CHECK(ids == (std::vector<int>{2, 4, 1, 3, 5}));
+  }
+
+  SECTION("discrete levels")
+  {
+    auto ch = channel<message, bucket_backend<3, level_of>>{};
+    ch.send(message{2, 1});
+    ch.send(message{1, 2});
+    ch.send(message{7, 3});
+    ch.send(message{0, 4});
+    ch.send(message{1, 5});
+    ch.emplace_send(message{0, 6});
+
+    auto ids = std::vector<int>{};
+    for (int i = 0; i < 6; ++i)
+      ids.push_back(ch.receive().id);
+    CHECK(ids == (std::vector<int>{4, 6, 2, 5, 1, 3}));
+  }
+
+  SECTION("bounded buffer applies back-pressure")
+  {
+    auto ch = channel<int, priority_backend<std::greater<int>>>(2u);
+    ch.send(5);
+    ch.send(3);
+    CHECK_FALSE(ch.try_send(1));
+
+    auto thr = std::thread{[&ch] { ch.send(1); }};
+    CHECK(ch.receive() == 3);
+    thr.join();
+
+    CHECK(ch.receive() == 1);
+    CHECK(ch.receive() == 5);
+
+    ch.close();
+    auto v = 0;
+    CHECK(ch.receive(v) == channel_status::closed);
+    CHECK_THROWS_AS(ch.send(1), closed_channel);
+  }
+}
+
+TEST_CASE("Instrumented channels", "[channel]")
+{
+  SECTION("counters")
+  {
+    auto ch = channel<int, instrumented<>>(2u);
+    auto s = ch.stats();
+    CHECK(s.sends == 0u);
+    CHECK(s.depth == 0u);
+
+    ch.send(1);
+    ch.send(2);
+    CHECK_FALSE(ch.try_send(3));
+    CHECK(ch.receive() == 1);
+
+    const auto values = std::vector<int>{4};
+    ch.send_range(values.begin(), values.end());
+
+    s = ch.stats();
+    CHECK(s.sends == 3u);
+    CHECK(s.receives == 1u);
+    CHECK(s.depth == 2u);
+    CHECK(s.high_water_depth == 2u);
+    CHECK(s.closes == 0u);
+
+    auto out = std::vector<int>{};
+    CHECK(ch.drain(out) == 2u);
+    ch.close();
+    ch.close();
+
+    const auto ich = ichannel<int, instrumented<>>{ch};
+    s = ich.stats();
+    CHECK(s.receives == 3u);
+    CHECK(s.depth == 0u);
+    CHECK(s.closes == 2u);
+  }
+
+  SECTION("blocking time")
+  {
+    auto ch = channel<int, instrumented<spsc_backend>>(1u);
+    auto thr = std::thread{[ch]() mutable {
+      std::this_thread::sleep_for(std::chrono::milliseconds{20});
+      ch.send(1);
+    }};
+    CHECK(ch.receive() == 1);
+    thr.join();
+
+    auto v = 0;
+    CHECK(ch.receive_for(v, std::chrono::milliseconds{5}) == channel_status::timeout);
+
+    const auto s = ch.stats();
+    CHECK(s.receive_blocked >= std::chrono::milliseconds{20});
+    CHECK(s.send_blocked == std::chrono::nanoseconds{0});
+    CHECK(s.receives == 1u);
+  }
+
+  SECTION("other backends")
+  {
+    auto mpmc = channel<int, instrumented<mpmc_backend>>(4u);
+    mpmc.send(1);
+    CHECK(mpmc.stats().depth == 1u);
+
+    auto prio = channel<int, instrumented<priority_backend<>>>{};
+    prio.send(1);
+    prio.send(2);
+    CHECK(prio.receive() == 2);
+    CHECK(prio.stats().high_water_depth == 2u);
+  }
+}
@@ -1,5 +1,17 @@
 #include <cool/thread_pool.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
 #include <catch2/catch_test_macros.hpp>
 
 TEST_CASE("Basic thread_pool functionalities", "[thread_pool]")
@@ -101,3 +113,870 @@ TEST_CASE("Thread pool exception safety", "[thread_pool]")
     pool.join();
   }
 }
+
+TEST_CASE("Work-stealing thread pool", "[thread_pool]")
+{
+  using namespace cool;
+
+  SECTION("external tasks")
+  {
+    thread_pool pool(4, scheduling::work_stealing);
+
+    std::vector<std::future<int>> futures;
+    for (int i = 0; i < 1000; ++i)
+      futures.push_back(pool.enqueue([i]() { return i * 2; }));
+
+    for (int i = 0; i < 1000; ++i)
+      CHECK(futures[i].get() == i * 2);
+
+    pool.join();
+    CHECK(pool.is_closed());
+    CHECK_THROWS_AS(pool.enqueue([] {}), closed_thread_pool);
+  }
+
+  SECTION("nested tasks are spread among workers")
+  {
+    thread_pool pool(4, scheduling::work_stealing);
+    std::atomic<int> count{0};
+
+    // Each task spawns two children down to a given depth, so most tasks are
+    // enqueued from workers into their local deques.
+    std::function<void(int)> spawn = [&](int depth) {
+      count.fetch_add(1);
+      if (depth > 0) {
+        pool.enqueue(spawn, depth - 1);
+        pool.enqueue(spawn, depth - 1);
+      }
+    };
+
+    pool.enqueue(spawn, 12);
+    while (count.load() < (1 << 13) - 1)
+      std::this_thread::yield();
+
+    pool.join();
+    CHECK(count.load() == (1 << 13) - 1);
+  }
+
+  SECTION("tasks enqueued before closing run")
+  {
+    std::atomic<int> count{0};
+    {
+      thread_pool pool(2, scheduling::work_stealing);
+      for (int i = 0; i < 100; ++i)
+        pool.enqueue([&count] { count.fetch_add(1); });
+      pool.join();
+    }
+    CHECK(count.load() == 100);
+  }
+}
+
+TEST_CASE("Posting tasks to a thread pool", "[thread_pool]")
+{
+  using namespace cool;
+
+  SECTION("posted tasks run")
+  {
+    std::atomic<int> count{0};
+    {
+      thread_pool pool(2);
+      for (int i = 0; i < 100; ++i)
+        pool.post([&count](int n) { count.fetch_add(n); }, 2);
+      pool.join();
+      CHECK_THROWS_AS(pool.post([] {}), closed_thread_pool);
+    }
+    CHECK(count.load() == 200);
+  }
+
+  SECTION("move-only and large callables")
+  {
+    thread_pool pool(2, scheduling::work_stealing);
+
+    auto ptr = std::unique_ptr<int>(new int{21});
+    struct doubler {
+      std::unique_ptr<int> p;
+      auto operator()() const -> int { return *p * 2; }
+    };
+    CHECK(pool.enqueue(doubler{std::move(ptr)}).get() == 42);
+
+    struct large {
+      long values[32];
+      auto operator()() const -> long { return values[0] + values[31]; }
+    };
+    auto big = large{};
+    big.values[0] = 1;
+    big.values[31] = 2;
+    CHECK(pool.enqueue(big).get() == 3);
+
+    std::atomic<long> sum{0};
+    pool.post([&sum, big] { sum.fetch_add(big()); });
+    pool.post([&sum](std::unique_ptr<int>& p) { sum.fetch_add(*p); }, std::unique_ptr<int>(new int{4}));
+    pool.join();
+    CHECK(sum.load() == 7);
+  }
+}
+
+namespace
+{
+
+auto check_parallel_loops(cool::scheduling mode) -> void
+{
+  using namespace cool;
+  thread_pool pool(4, mode);
+
+  // `enqueue_bulk` calls the function on each element.
+  std::atomic<int> total{0};
+  auto values = std::vector<int>{1, 2, 3, 4, 5};
+  pool.enqueue_bulk(values, [&total](int x) { total.fetch_add(x); }).get();
+  CHECK(total.load() == 15);
+
+  pool.enqueue_bulk(std::vector<int>{}, [&total](int x) { total.fetch_add(x); }).get();
+  CHECK(total.load() == 15);
+
+  // `parallel_for` visits each index once, whatever the grain.
+  auto hits = std::vector<std::atomic<int>>(10000);
+  for (auto& hit : hits)
+    hit.store(0);
+
+  for (const auto grain : {std::size_t{0}, std::size_t{1}, std::size_t{64}, std::size_t{100000}})
+    pool.parallel_for(indices(hits.size()), [&hits](std::size_t i) { hits[i].fetch_add(1); }, grain).get();
+
+  auto misses = 0;
+  for (const auto& hit : hits)
+    misses += hit.load() != 4;
+  CHECK(misses == 0);
+
+  std::atomic<long> sum{0};
+  pool.parallel_for(indices(-50, 50), [&sum](int i) { sum.fetch_add(i); }, 8).get();
+  CHECK(sum.load() == -50);
+
+  pool.parallel_for(indices(0), [](int) { FAIL(); }).get();
+
+  // Exceptions are forwarded to the future.
+  auto result = pool.parallel_for(indices(100), [](int i) {
+    if (i == 42)
+      throw std::runtime_error{"42"};
+  });
+  CHECK_THROWS_AS(result.get(), std::runtime_error);
+
+  auto bulk = pool.enqueue_bulk(indices(3), [](int) { throw std::logic_error{"bulk"}; });
+  CHECK_THROWS_AS(bulk.get(), std::logic_error);
+
+  // Loops can be nested.
+  std::atomic<int> count{0};
+  pool.parallel_for(indices(8), [&pool, &count](int) {
+        pool.parallel_for(indices(100), [&count](int) { count.fetch_add(1); }, 10);
+      }).get();
+  while (count.load() < 800)
+    std::this_thread::yield();
+  CHECK(count.load() == 800);
+
+  pool.join();
+  CHECK_THROWS_AS(pool.parallel_for(indices(4), [](int) {}), closed_thread_pool);
+  CHECK_THROWS_AS(pool.enqueue_bulk(indices(4), [](int) {}), closed_thread_pool);
+}
+
+} // namespace
+
+TEST_CASE("Bulk tasks and parallel loops", "[thread_pool]")
+{
+  SECTION("shared queue") { check_parallel_loops(cool::scheduling::shared_queue); }
+  SECTION("work stealing") { check_parallel_loops(cool::scheduling::work_stealing); }
+}
+
+TEST_CASE("Continuations on thread pool futures", "[thread_pool]")
+{
+  using namespace cool;
+
+  SECTION("pipelines run on a single worker")
+  {
+    thread_pool pool(1);
+
+    // With a single worker, blocking on a previous stage would deadlock.
+    auto pipelines = std::vector<task_future<int>>();
+    for (int i = 0; i < 100; ++i) {
+      auto first = pool.async([i] { return i; });
+      pipelines.push_back(first.then([](int x) { return x * 2; }).then([](int x) { return x + 1; }));
+      CHECK_FALSE(first.valid());
+    }
+
+    auto results = when_all(std::move(pipelines)).get();
+    REQUIRE(results.size() == 100u);
+    for (int i = 0; i < 100; ++i)
+      CHECK(results[i] == 2 * i + 1);
+
+    std::atomic<int> visited{0};
+    pool.async([&visited] { visited.fetch_add(1); }).then([&visited] { visited.fetch_add(1); }).get();
+    CHECK(visited.load() == 2);
+
+    pool.join();
+  }
+
+  SECTION("exceptions skip continuations")
+  {
+    thread_pool pool(2);
+    auto called = false;
+    auto future = pool.async([]() -> int { throw std::runtime_error{"first"}; }).then([&called](int x) {
+      called = true;
+      return x;
+    });
+    CHECK_THROWS_AS(future.get(), std::runtime_error);
+    CHECK_FALSE(called);
+    CHECK_THROWS_AS(future.get(), std::future_error);
+
+    auto futures = std::vector<task_future<void>>();
+    futures.push_back(pool.async([] {}));
+    futures.push_back(pool.async([] { throw std::logic_error{"second"}; }));
+    CHECK_THROWS_AS(when_all(std::move(futures)).get(), std::logic_error);
+
+    pool.join();
+  }
+
+  SECTION("when_all and when_any")
+  {
+    thread_pool pool(2);
+    CHECK(when_all(std::vector<task_future<int>>{}).get().empty());
+    CHECK(when_any(std::vector<task_future<int>>{}).get().index == static_cast<std::size_t>(-1));
+
+    std::atomic<bool> release{false};
+    auto futures = std::vector<task_future<int>>();
+    futures.push_back(pool.async([&release] {
+      while (!release.load())
+        std::this_thread::yield();
+      return 0;
+    }));
+    futures.push_back(pool.async([] { return 1; }));
+
+    auto any = when_any(std::move(futures)).get();
+    CHECK(any.index == 1u);
+    CHECK(any.futures[1].get() == 1);
+
+    release.store(true);
+    CHECK(any.futures[0].get() == 0);
+    pool.join();
+  }
+
+  SECTION("continuations run inline once the pool is closed")
+  {
+    thread_pool pool(1);
+    std::atomic<bool> release{false};
+    auto first = pool.async([&release] {
+      while (!release.load())
+        std::this_thread::yield();
+      return 20;
+    });
+    auto second = first.then([](int x) { return x + 1; });
+
+    pool.close();
+    release.store(true);
+    CHECK(second.get() == 21);
+    pool.join();
+  }
+}
+
+TEST_CASE("Task priorities", "[thread_pool]")
+{
+  using namespace cool;
+
+  // Keeps the worker busy until released, so that queued tasks pile up.
+  std::atomic<bool> started{false};
+  std::atomic<bool> release{false};
+  const auto block = [&started, &release](thread_pool& pool) {
+    pool.post([&started, &release] {
+      started.store(true);
+      while (!release.load())
+        std::this_thread::yield();
+    });
+    while (!started.load())
+      std::this_thread::yield();
+  };
+
+  SECTION("higher priorities run first")
+  {
+    auto order = std::vector<int>();
+    thread_pool pool(1);
+    block(pool);
+
+    pool.post(task_priority::low, [&order] { order.push_back(3); });
+    pool.post([&order] { order.push_back(2); });
+    auto high = pool.enqueue(task_priority::high, [&order] {
+      order.push_back(1);
+      return 1;
+    });
+    pool.post(task_priority::normal, [&order] { order.push_back(2); });
+
+    release.store(true);
+    CHECK(high.get() == 1);
+    pool.join();
+    CHECK(order == (std::vector<int>{1, 2, 2, 3}));
+  }
+
+  SECTION("low priorities age")
+  {
+    auto order = std::vector<int>();
+    thread_pool pool(1);
+    block(pool);
+
+    pool.post(task_priority::low, [&order] { order.push_back(-1); });
+    for (int i = 0; i < 100; ++i)
+      pool.post(task_priority::high, [&order, i] { order.push_back(i); });
+
+    release.store(true);
+    pool.join();
+    REQUIRE(order.size() == 101u);
+    CHECK(order[32] == -1);
+  }
+
+  SECTION("high priorities overtake local deques")
+  {
+    auto order = std::vector<int>();
+    thread_pool pool(1, scheduling::work_stealing);
+    pool.enqueue([&pool, &order] {
+          for (int i = 0; i < 3; ++i)
+            pool.post([&order] { order.push_back(2); });
+          pool.post(task_priority::high, [&order] { order.push_back(1); });
+        }).get();
+    pool.join();
+    CHECK(order == (std::vector<int>{1, 2, 2, 2}));
+  }
+}
+
+namespace
+{
+
+auto fib(cool::thread_pool& pool, int n) -> long
+{
+  if (n < 2)
+    return n;
+
+  auto left = pool.enqueue(fib, std::ref(pool), n - 1);
+  const auto right = fib(pool, n - 2);
+  pool.wait(left);
+  return left.get() + right;
+}
+
+auto async_fib(cool::thread_pool& pool, int n) -> long
+{
+  if (n < 2)
+    return n;
+
+  auto left = pool.async(async_fib, std::ref(pool), n - 1);
+  const auto right = async_fib(pool, n - 2);
+  return left.get() + right;
+}
+
+} // namespace
+
+TEST_CASE("Waiting for tasks from tasks", "[thread_pool]")
+{
+  using namespace cool;
+
+  SECTION("shared queue")
+  {
+    // Without helping, two workers would deadlock waiting for their children.
+    thread_pool pool(2);
+    CHECK(fib(pool, 15) == 610);
+    CHECK(pool.enqueue(fib, std::ref(pool), 15).get() == 610);
+    CHECK(pool.async(async_fib, std::ref(pool), 15).get() == 610);
+    pool.join();
+  }
+
+  SECTION("work stealing")
+  {
+    thread_pool pool(2, scheduling::work_stealing);
+    CHECK(pool.enqueue(fib, std::ref(pool), 15).get() == 610);
+    CHECK(pool.async(async_fib, std::ref(pool), 15).get() == 610);
+    pool.join();
+  }
+
+  SECTION("other threads help with the shared queue")
+  {
+    thread_pool pool(1);
+    std::atomic<bool> started{false};
+    std::atomic<bool> release{false};
+    pool.post([&started, &release] {
+      started.store(true);
+      while (!release.load())
+        std::this_thread::yield();
+    });
+    while (!started.load())
+      std::this_thread::yield();
+
+    // The only worker is busy, so this thread runs the task itself.
+    auto id = pool.enqueue([] { return std::this_thread::get_id(); });
+    pool.wait(id);
+    CHECK(id.get() == std::this_thread::get_id());
+
+    release.store(true);
+    pool.join();
+  }
+
+  SECTION("waiting threads sleep until there is work or a result")
+  {
+    thread_pool pool(1);
+    std::atomic<bool> release{false};
+    auto result = pool.async([&release] {
+      while (!release.load())
+        std::this_thread::yield();
+      return 42;
+    });
+
+    // Only the waiting thread can run the releasing task, which is queued
+    // once it went to sleep.
+    auto releaser = std::thread([&pool, &release] {
+      std::this_thread::sleep_for(std::chrono::milliseconds{20});
+      pool.post([&release] { release.store(true); });
+    });
+    pool.wait(result);
+    CHECK(result.get() == 42);
+
+    releaser.join();
+    pool.join();
+  }
+}
+
+TEST_CASE("Elastic thread pools", "[thread_pool]")
+{
+  using namespace cool;
+
+  const auto eventually = [](const std::function<bool()>& condition) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+    while (!condition() && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    return condition();
+  };
+
+  SECTION("workers are started as tasks back up and retire when idle")
+  {
+    thread_pool pool(elastic_limits{1, 4, std::chrono::milliseconds{20}});
+    CHECK(pool.thread_count() == 1u);
+    CHECK(pool.joinable());
+
+    // Tasks blocking their worker force the pool to start new ones.
+    std::atomic<bool> release{false};
+    std::atomic<int> running{0};
+    auto futures = std::vector<std::future<void>>();
+    for (int i = 0; i < 6; ++i) {
+      futures.push_back(pool.enqueue([&release, &running] {
+        running.fetch_add(1);
+        while (!release.load())
+          std::this_thread::yield();
+      }));
+    }
+
+    CHECK(eventually([&running] { return running.load() == 4; }));
+    CHECK(pool.thread_count() == 4u);
+
+    release.store(true);
+    for (auto& future : futures)
+      future.get();
+
+    CHECK(eventually([&pool] { return pool.thread_count() == 1u; }));
+
+    // Retired workers are replaced when needed.
+    CHECK(pool.enqueue([] { return 5; }).get() == 5);
+    pool.join();
+    CHECK_FALSE(pool.joinable());
+    CHECK(pool.thread_count() == 0u);
+  }
+
+  SECTION("pools can start without workers")
+  {
+    thread_pool pool(elastic_limits{0, 2, std::chrono::milliseconds{10}});
+    CHECK(pool.thread_count() == 0u);
+    // Read from a task, as the worker may retire as soon as it is done.
+    CHECK(pool.enqueue([&pool] { return pool.thread_count(); }).get() >= 1u);
+    CHECK(eventually([&pool] { return pool.thread_count() == 0u; }));
+    pool.join();
+  }
+
+  SECTION("limits are checked")
+  {
+    CHECK_THROWS_AS(thread_pool(elastic_limits{0, 0}), std::invalid_argument);
+    CHECK_THROWS_AS(thread_pool(elastic_limits{3, 2}), std::invalid_argument);
+  }
+
+  SECTION("fixed pools count their workers")
+  {
+    thread_pool pool(3);
+    CHECK(pool.thread_count() == 3u);
+    pool.join();
+    CHECK(pool.thread_count() == 0u);
+  }
+}
+
+TEST_CASE("Thread pool statistics", "[thread_pool]")
+{
+  using namespace cool;
+
+  SECTION("duration histograms")
+  {
+    auto histogram = duration_histogram{};
+    histogram.counts.fill(0);
+    CHECK(histogram.quantile(0.5) == std::chrono::nanoseconds{0});
+
+    histogram.counts[3] = 90;  // [8, 16) ns
+    histogram.counts[10] = 10; // [1024, 2048) ns
+    CHECK(histogram.total() == 100u);
+    CHECK(histogram.quantile(0.5) == std::chrono::nanoseconds{16});
+    CHECK(histogram.quantile(0.99) == std::chrono::nanoseconds{2048});
+  }
+
+  SECTION("tasks and workers")
+  {
+    for (const auto mode : {scheduling::shared_queue, scheduling::work_stealing}) {
+      thread_pool pool(2, mode);
+      pool.enqueue([] {}).get(); // Not counted.
+
+      pool.enable_stats();
+      for (int i = 0; i < 100; ++i)
+        pool.post([] { std::this_thread::sleep_for(std::chrono::microseconds{10}); });
+      pool.join();
+
+      const auto stats = pool.stats();
+      CHECK(stats.tasks == 100u);
+      CHECK(stats.queue_latency.total() == 100u);
+      CHECK(stats.run_time.total() == 100u);
+      CHECK(stats.run_time.quantile(0.5) >= std::chrono::microseconds{10});
+      CHECK(stats.queued == 0u);
+      CHECK(stats.threads == 0u);
+
+      REQUIRE(stats.workers.size() == 2u);
+      CHECK(stats.workers[0].tasks + stats.workers[1].tasks == 100u);
+      CHECK_FALSE(stats.workers[0].running);
+      CHECK(stats.utilization() > 0.0);
+      CHECK(stats.utilization() <= 1.0);
+    }
+  }
+
+  SECTION("retired elastic workers")
+  {
+    thread_pool pool(elastic_limits{0, 2, std::chrono::milliseconds{1}});
+    pool.enable_stats();
+
+    // Each task starts a worker, which retires before the next one.
+    for (int i = 0; i < 100; ++i) {
+      pool.enqueue([] {}).get();
+      while (pool.thread_count() != 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    }
+
+    auto stats = pool.stats();
+    CHECK(stats.tasks == 100u);
+    CHECK(stats.workers.size() <= 2u);
+
+    auto tasks = stats.retired.tasks;
+    for (const auto& worker : stats.workers)
+      tasks += worker.tasks;
+    CHECK(tasks == 100u);
+    CHECK(stats.utilization() > 0.0);
+    pool.join();
+  }
+
+  SECTION("queue length")
+  {
+    thread_pool pool(1);
+    std::atomic<bool> started{false};
+    std::atomic<bool> release{false};
+    pool.post([&started, &release] {
+      started.store(true);
+      while (!release.load())
+        std::this_thread::yield();
+    });
+    while (!started.load())
+      std::this_thread::yield();
+
+    for (int i = 0; i < 3; ++i)
+      pool.post([] {});
+    const auto stats = pool.stats();
+    CHECK(stats.queued == 3u);
+    CHECK(stats.threads == 1u);
+    CHECK(stats.tasks == 0u);
+
+    release.store(true);
+    pool.join();
+  }
+
+  SECTION("Chrome traces")
+  {
+    auto out = std::ostringstream{};
+    {
+      thread_pool pool(2);
+      pool.set_trace_hook(chrome_trace{out});
+      for (int i = 0; i < 3; ++i)
+        pool.post([] {});
+      pool.join();
+      pool.set_trace_hook(nullptr);
+    }
+
+    const auto trace = out.str();
+    CHECK(trace.substr(0, 3) == "[\n{");
+    CHECK(trace.substr(trace.size() - 3) == "\n]\n");
+
+    auto events = 0;
+    for (auto at = trace.find("\"ph\":\"X\""); at != std::string::npos; at = trace.find("\"ph\":\"X\"", at + 1))
+      ++events;
+    CHECK(events == 3);
+  }
+}
+
+TEST_CASE("Shutdown policies and cancellation", "[thread_pool]")
+{
+  using namespace cool;
+
+  std::atomic<bool> started{false};
+  std::atomic<bool> release{false};
+  const auto block = [&started, &release] {
+    started.store(true);
+    while (!release.load())
+      std::this_thread::yield();
+  };
+  const auto wait_started = [&started] {
+    while (!started.load())
+      std::this_thread::yield();
+  };
+
+  SECTION("Cancellation tokens")
+  {
+    auto token = cancellation_token{};
+    CHECK_FALSE(token.is_cancelled());
+
+    auto source = cancellation_source{};
+    token = source.token();
+    CHECK_FALSE(source.is_cancelled());
+    CHECK_FALSE(token.is_cancelled());
+
+    source.cancel();
+    CHECK(source.is_cancelled());
+    CHECK(token.is_cancelled());
+  }
+
+  SECTION("Draining runs all tasks")
+  {
+    std::atomic<int> count{0};
+    thread_pool pool(1);
+    pool.post(block);
+    wait_started();
+    for (int i = 0; i < 10; ++i)
+      pool.post([&count] { count.fetch_add(1); });
+
+    release.store(true);
+    pool.join(shutdown_policy::drain);
+    CHECK(count.load() == 10);
+    CHECK_FALSE(pool.token().is_cancelled());
+  }
+
+  SECTION("Cancelling pending tasks breaks their promises")
+  {
+    std::atomic<int> count{0};
+    thread_pool pool(1);
+    auto running = pool.enqueue(block);
+    wait_started();
+
+    auto pending = pool.enqueue([&count] { count.fetch_add(1); });
+    auto value = pool.async([] { return 42; });
+    auto loop = pool.parallel_for(indices(16), [&count](int) { count.fetch_add(1); }, 1);
+    auto next = value.then([](int x) { return x + 1; });
+
+    auto token = pool.token();
+    CHECK(pool.cancel_pending() > 0u);
+    CHECK(token.is_cancelled());
+    release.store(true);
+    pool.join(shutdown_policy::cancel_pending);
+
+    CHECK_NOTHROW(running.get());
+    CHECK(count.load() == 0);
+    CHECK_THROWS_AS(pending.get(), std::future_error);
+    CHECK_THROWS_AS(value.get(), std::future_error);
+    CHECK_THROWS_AS(loop.get(), std::future_error);
+    CHECK_THROWS_AS(next.get(), std::future_error);
+  }
+
+  SECTION("Tasks enqueued after cancelling see a fresh token")
+  {
+    thread_pool pool(1);
+    auto before = pool.token();
+    CHECK(pool.cancel_pending() == 0u);
+    CHECK(before.is_cancelled());
+
+    auto after = pool.token();
+    CHECK_FALSE(after.is_cancelled());
+    auto live = pool.async([&pool] { return pool.token().is_cancelled(); });
+    CHECK_FALSE(live.get());
+
+    pool.join(shutdown_policy::cancel_pending);
+    CHECK(after.is_cancelled());
+    CHECK(pool.token().is_cancelled());
+  }
+
+  SECTION("Running tasks observe the token")
+  {
+    thread_pool pool(1);
+    auto token = pool.token();
+    auto stopped = pool.async([token, &started] {
+      started.store(true);
+      while (!token.is_cancelled())
+        std::this_thread::yield();
+      return true;
+    });
+    wait_started();
+    pool.join(shutdown_policy::cancel_pending);
+    CHECK(stopped.get());
+  }
+
+  SECTION("Draining with a deadline")
+  {
+    std::atomic<int> count{0};
+    thread_pool pool(1);
+    for (int i = 0; i < 5; ++i)
+      pool.post([&count] { count.fetch_add(1); });
+    CHECK(pool.join_for(std::chrono::seconds{10}));
+    CHECK(count.load() == 5);
+  }
+
+  SECTION("Missing the deadline drops pending tasks")
+  {
+    std::atomic<int> count{0};
+    thread_pool pool(1);
+    pool.post(block);
+    wait_started();
+    auto pending = pool.enqueue([&count] { count.fetch_add(1); });
+
+    auto helper = std::thread([&release] {
+      std::this_thread::sleep_for(std::chrono::milliseconds{50});
+      release.store(true);
+    });
+    CHECK_FALSE(pool.join_for(std::chrono::milliseconds{10}));
+    helper.join();
+
+    CHECK(count.load() == 0);
+    CHECK_THROWS_AS(pending.get(), std::future_error);
+  }
+}
+
+TEST_CASE("Bounded thread pool queues", "[thread_pool]")
+{
+  using namespace cool;
+
+  std::atomic<bool> started{false};
+  std::atomic<bool> release{false};
+  const auto block = [&started, &release] {
+    started.store(true);
+    while (!release.load())
+      std::this_thread::yield();
+  };
+  const auto wait_started = [&started] {
+    while (!started.load())
+      std::this_thread::yield();
+  };
+
+  SECTION("Caller runs")
+  {
+    thread_pool pool(1);
+    pool.set_queue_limit(2, overflow_policy::caller_runs);
+    pool.post(block);
+    wait_started();
+
+    std::atomic<int> count{0};
+    for (int i = 0; i < 2; ++i)
+      pool.post([&count] { count.fetch_add(1); });
+    auto here = pool.enqueue([] { return std::this_thread::get_id(); });
+    CHECK(here.wait_for(std::chrono::seconds{0}) == std::future_status::ready);
+    CHECK(here.get() == std::this_thread::get_id());
+
+    auto bulk = pool.enqueue_bulk(indices(5), [&count](int) { count.fetch_add(1); });
+    CHECK(count.load() == 5);
+
+    const auto stats = pool.stats();
+    CHECK(stats.queued == 2u);
+    CHECK(stats.overflows == 2u);
+
+    release.store(true);
+    bulk.get();
+    pool.join();
+    CHECK(count.load() == 7);
+  }
+
+  SECTION("Reject")
+  {
+    thread_pool pool(1);
+    pool.set_queue_limit(1, overflow_policy::reject);
+    pool.post(block);
+    wait_started();
+
+    std::atomic<int> count{0};
+    pool.post([&count] { count.fetch_add(1); });
+    CHECK_THROWS_AS(pool.post([&count] { count.fetch_add(1); }), full_thread_pool);
+    CHECK_THROWS_AS(pool.enqueue([] {}), full_thread_pool);
+    CHECK_THROWS_AS(pool.async([] {}), full_thread_pool);
+
+    release.store(true);
+    pool.join();
+    CHECK(count.load() == 1);
+  }
+
+  SECTION("Block")
+  {
+    thread_pool pool(1);
+    pool.set_queue_limit(1, overflow_policy::block);
+    pool.post(block);
+    wait_started();
+    pool.post([] {});
+
+    std::atomic<bool> submitted{false};
+    auto submitter = std::thread([&pool, &submitted] {
+      pool.post([] {});
+      submitted.store(true);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds{20});
+    CHECK_FALSE(submitted.load());
+
+    release.store(true);
+    submitter.join();
+    CHECK(submitted.load());
+    pool.join();
+  }
+
+  SECTION("Closing wakes blocked submitters")
+  {
+    thread_pool pool(1);
+    pool.set_queue_limit(1);
+    pool.post(block);
+    wait_started();
+    pool.post([] {});
+
+    auto submitter = std::thread([&pool] { CHECK_THROWS_AS(pool.post([] {}), closed_thread_pool); });
+    std::this_thread::sleep_for(std::chrono::milliseconds{20});
+    pool.close();
+    submitter.join();
+
+    release.store(true);
+    pool.join();
+  }
+
+  SECTION("Workers don't wait for room")
+  {
+    thread_pool pool(1);
+    pool.set_queue_limit(1, overflow_policy::block);
+    const auto ids = pool.enqueue([&pool] {
+      pool.post(task_priority::high, [] {});
+      auto inner = pool.enqueue(task_priority::high, [] { return std::this_thread::get_id(); });
+      return std::make_pair(std::this_thread::get_id(), inner.get());
+    }).get();
+    CHECK(ids.first == ids.second);
+    pool.join();
+  }
+
+  SECTION("Bounded load")
+  {
+    std::atomic<int> count{0};
+    for (auto mode : {scheduling::shared_queue, scheduling::work_stealing}) {
+      thread_pool pool(2, mode);
+      pool.set_queue_limit(4);
+      for (int i = 0; i < 1000; ++i)
+        pool.post([&count] { count.fetch_add(1); });
+      pool.parallel_for(indices(1000), [&count](int) { count.fetch_add(1); }, 10).get();
+      pool.join();
+    }
+    CHECK(count.load() == 4000);
+  }
+}
@@ -0,0 +1,134 @@
+#include <cool/broadcast.hpp>
+#include <cool/channel.hpp>
+#include <cool/thread_pool.hpp>
+#include <cool/wait_strategy.hpp>
+
+#include <chrono>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace cool;
+
+namespace
+{
+template <typename Backend> auto ping_pong(wait_strategy strategy) -> void
+{
+  auto ping = channel<int, Backend>(1u, strategy);
+  auto pong = channel<int, Backend>(1u, strategy);
+
+  auto thr = std::thread{[ping, pong]() mutable {
+    auto v = 0;
+    while (ping.receive(v) == channel_status::ok)
+      pong.send(v + 1);
+    pong.close();
+  }};
+
+  for (int i = 0; i < 1000; ++i) {
+    ping.send(i);
+    CHECK(pong.receive() == i + 1);
+  }
+  ping.close();
+  thr.join();
+
+  auto v = 0;
+  CHECK(pong.receive(v) == channel_status::closed);
+}
+} // namespace
+
+TEST_CASE("Wait strategies", "[wait_strategy]")
+{
+  const wait_strategy strategies[] = {wait_strategy::block(), wait_strategy::spin_then_block(),
+                                      wait_strategy::spin_then_block(0), wait_strategy::yield(),
+                                      wait_strategy::busy_spin()};
+
+  CHECK(wait_strategy::block().parks());
+  CHECK(wait_strategy::spin_then_block().parks());
+  CHECK_FALSE(wait_strategy::yield().parks());
+  CHECK_FALSE(wait_strategy::busy_spin().parks());
+  CHECK(wait_strategy::spin_then_block(0) != wait_strategy::spin_then_block());
+  CHECK(wait_strategy::yield() == wait_strategy::yield());
+
+  SECTION("channels")
+  {
+    for (const auto strategy : strategies) {
+      ping_pong<mutex_backend>(strategy);
+      ping_pong<spsc_backend>(strategy);
+      ping_pong<mpmc_backend>(strategy);
+    }
+  }
+
+  SECTION("only unbounded channels take a strategy alone")
+  {
+    static_assert(std::is_constructible<channel<int>, wait_strategy>::value, "");
+    static_assert(std::is_constructible<channel<int, priority_backend<>>, wait_strategy>::value, "");
+    static_assert(std::is_constructible<channel<int, instrumented<mutex_backend>>, wait_strategy>::value, "");
+    static_assert(!std::is_constructible<channel<int, spsc_backend>, wait_strategy>::value, "");
+    static_assert(!std::is_constructible<channel<int, mpmc_backend>, wait_strategy>::value, "");
+    static_assert(!std::is_constructible<channel<int, instrumented<spsc_backend>>, wait_strategy>::value, "");
+    static_assert(!std::is_constructible<channel<int, instrumented<mpmc_backend>>, wait_strategy>::value, "");
+
+    auto ch = channel<int, instrumented<mutex_backend>>{wait_strategy::yield()};
+    ch.send(1);
+    CHECK(ch.receive() == 1);
+  }
+
+  SECTION("timed waits expire")
+  {
+    for (const auto strategy : strategies) {
+      auto ch = channel<int, mpmc_backend>(2u, strategy);
+      auto unbounded = channel<int>{strategy};
+      auto v = 0;
+      CHECK(ch.receive_for(v, std::chrono::milliseconds{2}) == channel_status::timeout);
+      CHECK(unbounded.receive_for(v, std::chrono::milliseconds{2}) == channel_status::timeout);
+    }
+  }
+
+  SECTION("closing wakes waiters")
+  {
+    for (const auto strategy : strategies) {
+      auto ch = channel<int, spsc_backend>(2u, strategy);
+      auto thr = std::thread{[ch]() mutable {
+        auto v = 0;
+        CHECK(ch.receive(v) == channel_status::closed);
+      }};
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+      ch.close();
+      thr.join();
+    }
+  }
+
+  SECTION("broadcast")
+  {
+    for (const auto strategy : strategies) {
+      auto ch = broadcast<int>{1u, broadcast_policy::block, strategy};
+      auto sub = ch.subscribe();
+      auto thr = std::thread{[&sub] {
+        auto sum = 0;
+        auto v = 0;
+        while (sub.receive(v) == channel_status::ok)
+          sum += v;
+        CHECK(sum == 4950);
+      }};
+      for (int i = 0; i < 100; ++i)
+        ch.publish(i);
+      ch.close();
+      thr.join();
+    }
+  }
+
+  SECTION("thread pools")
+  {
+    for (const auto strategy : strategies) {
+      thread_pool pool{2, strategy};
+      auto results = std::vector<std::future<int>>{};
+      for (int i = 0; i < 100; ++i)
+        results.push_back(pool.enqueue([i] { return 2 * i; }));
+      for (int i = 0; i < 100; ++i)
+        CHECK(results[i].get() == 2 * i);
+      pool.join();
+    }
+  }
+}
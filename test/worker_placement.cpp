@@ -0,0 +1,140 @@
+#include <cool/thread_pool.hpp>
+#include <cool/worker_placement.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace cool;
+
+TEST_CASE("CPU lists", "[worker_placement]")
+{
+  CHECK(detail::parse_cpu_list("0") == (std::vector<unsigned>{0}));
+  CHECK(detail::parse_cpu_list("0-3,8,10-11\n") == (std::vector<unsigned>{0, 1, 2, 3, 8, 10, 11}));
+  CHECK(detail::parse_cpu_list("").empty());
+  CHECK_FALSE(detail::allowed_cpus().empty());
+}
+
+TEST_CASE("Worker placements", "[worker_placement]")
+{
+  CHECK(worker_placement::anywhere().groups() == 0u);
+  CHECK(worker_placement::cores().groups() == 1u);
+  CHECK(worker_placement::cores().cpus() == detail::allowed_cpus().size());
+  CHECK(worker_placement::numa_nodes().groups() >= 1u);
+  CHECK(worker_placement::numa_nodes().cpus() == detail::allowed_cpus().size());
+  CHECK_THROWS_AS(worker_placement::cpu_sets({{0}, {}}), std::invalid_argument);
+
+  const auto sets = worker_placement::cpu_sets({{0, 1}, {2}});
+  CHECK(sets.groups() == 2u);
+  CHECK(sets.cpus() == 3u);
+  CHECK(sets.slot_of(0).group == 0u);
+  CHECK(sets.slot_of(0).cpus == (std::vector<unsigned>{0, 1}));
+  CHECK(sets.slot_of(1).group == 1u);
+  CHECK(sets.slot_of(2).group == 0u);
+  CHECK(sets.slot_of(3).group == 0u);
+  CHECK(sets.slot_of(4).group == 1u);
+
+  // Groups get workers before any group gets a second one.
+  const auto nodes = worker_placement::cpu_sets({{0, 1, 2, 3}, {4, 5, 6, 7}});
+  CHECK(nodes.slot_of(0).group == 0u);
+  CHECK(nodes.slot_of(1).group == 1u);
+
+  const auto cores = worker_placement::cores();
+  CHECK(cores.slot_of(0).cpus.size() == 1u);
+}
+
+TEST_CASE("Thread pools with placed workers", "[worker_placement]")
+{
+  const auto cpu = detail::allowed_cpus().front();
+
+#if defined(__linux__)
+  SECTION("workers are pinned")
+  {
+    thread_pool pool(0, worker_placement::cores());
+    auto pinned = pool.enqueue([] {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      sched_getaffinity(0, sizeof(set), &set);
+      return CPU_COUNT(&set);
+    });
+    CHECK(pinned.get() == 1);
+    pool.join();
+  }
+#endif
+
+  SECTION("tasks of a busy node run on other nodes")
+  {
+    for (const auto mode : {scheduling::shared_queue, scheduling::work_stealing}) {
+      // Fewer workers than CPUs in the first group: still one worker per group.
+      thread_pool pool(2, worker_placement::cpu_sets({{cpu, cpu, cpu}, {cpu}}), mode);
+      CHECK(pool.nodes() == 2u);
+
+      for (std::size_t node = 0; node < 2; ++node)
+        for (int i = 0; i < 50; ++i)
+          CHECK(pool.enqueue_on(node, [i] { return i; }).get() == i);
+
+      // Whichever worker the first task blocks, the other one runs the second task.
+      for (std::size_t node = 0; node < 2; ++node) {
+        std::atomic<bool> release{false};
+        auto blocked = pool.enqueue_on(node, [&release] {
+          while (!release.load())
+            std::this_thread::yield();
+          return std::this_thread::get_id();
+        });
+        const auto other = pool.enqueue_on(node, [] { return std::this_thread::get_id(); }).get();
+        release.store(true);
+        CHECK(blocked.get() != other);
+      }
+
+      CHECK(pool.enqueue_on(7, [] { return 3; }).get() == 3);
+      pool.join();
+      CHECK_THROWS_AS(pool.post_on(0, [] {}), closed_thread_pool);
+    }
+  }
+
+  SECTION("submitters blocked on a full queue wake the workers of each node")
+  {
+    for (const auto mode : {scheduling::shared_queue, scheduling::work_stealing}) {
+      thread_pool pool(2, worker_placement::cpu_sets({{cpu}, {cpu}}), mode);
+      pool.set_queue_limit(1, overflow_policy::block);
+
+      std::atomic<int> count{0};
+      for (int i = 0; i < 100; ++i) {
+        pool.post_on(static_cast<std::size_t>(i % 2), [&count] { count.fetch_add(1); });
+        pool.post([&count] { count.fetch_add(1); });
+      }
+      pool.join();
+      CHECK(count.load() == 200);
+    }
+  }
+
+  SECTION("tasks of nodes without workers run on other nodes")
+  {
+    for (const auto mode : {scheduling::shared_queue, scheduling::work_stealing}) {
+      thread_pool pool(1, worker_placement::cpu_sets({{cpu}, {cpu}}), mode);
+      CHECK(pool.nodes() == 2u);
+      CHECK(pool.enqueue_on(1, [] { return 5; }).get() == 5);
+
+      // Queued while the only worker is busy, and still run before `join` returns.
+      std::atomic<bool> release{false};
+      pool.post_on(0, [&release] {
+        while (!release.load())
+          std::this_thread::yield();
+      });
+      auto pending = pool.enqueue_on(1, [] { return 6; });
+      release.store(true);
+      pool.join();
+      CHECK(pending.wait_for(std::chrono::seconds{0}) == std::future_status::ready);
+      CHECK(pending.get() == 6);
+    }
+  }
+
+  thread_pool pool(2);
+  CHECK(pool.nodes() == 0u);
+  CHECK(pool.enqueue_on(0, [] { return 1; }).get() == 1);
+  pool.join();
+}